@@ -0,0 +1,229 @@
+/*
+ * gpiox microbenchmark
+ *
+ * measures latency percentiles and throughput of gpiox functions
+ * on simulated chip or on real /dev/gpiochip0
+ *
+ * build:
+ * > make
+ *
+ * run on simulated chip with 1us ioctl latency:
+ * > ./bench -s -l 1000
+ *
+ * run on real chip (pins 20..27 must be free):
+ * > ./bench
+ *
+ * bench.cpp
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "gpiox.h"
+#include "gpiox_def.h"
+#include "gpiox_int.h"
+#include "gpiox_pin.h"
+#include "sim_chip.h"
+
+#define FIRST_PIN 20   // first pin of bench pins
+#define N_BENCH_PIN 8  // pins 20..27
+#define N_ITER 100000  // default iterations
+#define GROUP 0
+
+// runs fn n times, prints percentiles of latency and throughput
+template <typename T>
+static void bench(const char* name, uint32_t n, T fn)
+{
+    std::vector<uint64_t> lat(n);
+    uint32_t errors = 0;
+
+    uint64_t start = get_time_ns();
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t t = get_time_ns();
+
+        if (!fn(i))
+            errors++;
+
+        lat[i] = get_time_ns() - t;
+    }
+
+    uint64_t total = get_time_ns() - start;
+
+    std::sort(lat.begin(), lat.end());
+
+    printf("%-24s %10.0f ops/s  p50 %7lu ns  p90 %7lu ns  p99 %7lu ns  max %8lu ns%s\n",
+        name,
+        (total > 0) ? n * (double) NS_PER_S / total : 0.0,
+        (unsigned long) lat[n / 2],
+        (unsigned long) lat[n * 9 / 10],
+        (unsigned long) lat[n * 99 / 100],
+        (unsigned long) lat[n - 1],
+        (errors > 0) ? "  (errors)" : "");
+}
+
+static void bench_all(uint32_t n)
+{
+    uint32_t val;
+
+    gpiox_init(FIRST_PIN, GPIO_MODE_OUTPUT, 0);
+    gpiox_init(FIRST_PIN + 1, GPIO_MODE_INPUT_PULLDOWN, 0);
+
+    bench("write", n, [](uint32_t i) { return gpiox_write(FIRST_PIN, i & 1); });
+    bench("read", n, [&val](uint32_t) { return gpiox_read(FIRST_PIN + 1, val); });
+
+    // compile-time pin handles
+    {
+        gpiox::pin<FIRST_PIN + 2, GPIO_MODE_OUTPUT> out;
+        gpiox::pin<FIRST_PIN + 3, GPIO_MODE_INPUT_PULLDOWN> in;
+
+        bench("write pin handle", n, [&out](uint32_t i) { return out.write(i & 1); });
+        bench("read pin handle", n, [&in, &val](uint32_t) { return in.read(val); });
+    }
+
+    // mode switch with line release and request
+    bench("mode switch init", n / 10, [](uint32_t i) {
+        return gpiox_init(FIRST_PIN + 1, (i & 1) ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT_PULLDOWN, 0);
+    });
+
+    // mode switch on requested line
+    bench("mode switch reconfigure", n / 10, [](uint32_t i) {
+        return gpiox_reconfigure(FIRST_PIN + 1, (i & 1) ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT_PULLDOWN, 0);
+    });
+
+    // all bench pins one by one
+    for (uint32_t pin = FIRST_PIN; pin < FIRST_PIN + N_BENCH_PIN; pin++)
+        gpiox_init(pin, GPIO_MODE_OUTPUT, 0);
+
+    bench("write 8 pins single", n / 10, [](uint32_t i) {
+        bool ret = true;
+
+        for (uint32_t pin = FIRST_PIN; pin < FIRST_PIN + N_BENCH_PIN; pin++)
+            ret &= gpiox_write(pin, i & 1);
+
+        return ret;
+    });
+
+    bench("read 8 pins single", n / 10, [&val](uint32_t) {
+        bool ret = true;
+
+        for (uint32_t pin = FIRST_PIN; pin < FIRST_PIN + N_BENCH_PIN; pin++)
+            ret &= gpiox_read(pin, val);
+
+        return ret;
+    });
+
+    uint32_t mask = ((1U << N_BENCH_PIN) - 1) << FIRST_PIN;
+    uint32_t bits;
+
+    bench("write 8 pins mask", n / 10, [mask](uint32_t i) { return gpiox_write_mask(mask, (i & 1) ? mask : 0); });
+    bench("read 8 pins mask", n / 10, [mask, &bits](uint32_t) { return gpiox_read_mask(mask, bits); });
+
+    for (uint32_t pin = FIRST_PIN; pin < FIRST_PIN + N_BENCH_PIN; pin++)
+        gpiox_deinit(pin);
+
+    // all bench pins in one line request
+    uint32_t pins[N_BENCH_PIN];
+    uint32_t modes[N_BENCH_PIN];
+    uint32_t setvals[N_BENCH_PIN];
+
+    for (uint32_t i = 0; i < N_BENCH_PIN; i++)
+    {
+        pins[i] = FIRST_PIN + i;
+        modes[i] = GPIO_MODE_OUTPUT;
+        setvals[i] = 0;
+    }
+
+    if (!gpiox_group_init(GROUP, pins, modes, setvals, N_BENCH_PIN))
+    {
+        puts("group init failed");
+        return;
+    }
+
+    uint64_t group_bits;
+
+    bench("write 8 pins group", n / 10, [](uint32_t i) { return gpiox_group_write(GROUP, 0xFF, (i & 1) ? 0xFF : 0); });
+    bench("read 8 pins group", n / 10, [&group_bits](uint32_t) { return gpiox_group_read(GROUP, group_bits); });
+
+    gpiox_group_deinit(GROUP);
+}
+
+int main(int argc, char* argv[])
+{
+    bool sim = false;
+    uint64_t latency_ns = 0;
+    uint32_t n = N_ITER;
+    const char* mem_name = nullptr;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "sl:n:m:")) != -1)
+    {
+        switch(opt)
+        {
+        case 's':
+            sim = true;
+            break;
+
+        case 'l':
+            latency_ns = strtoull(optarg, nullptr, 10);
+            break;
+
+        case 'n':
+            n = strtoul(optarg, nullptr, 10);
+            break;
+
+        case 'm':
+            mem_name = optarg;
+            break;
+
+        default:
+            puts("usage: bench [-s] [-l ioctl latency ns] [-n iterations] [-m register file]");
+            puts("  -s  simulated chip instead of /dev/gpiochip0");
+            puts("  -m  register backend on file (e.g. /dev/gpiomem or file of 4096 bytes)");
+            return 1;
+        }
+    }
+
+    if (n < 100)
+        n = 100;
+
+    if (sim && !sim_chip_init(latency_ns))
+    {
+        puts("simulated chip failed");
+        return 1;
+    }
+
+    if (gpiox_get_chipname()[0] == 0)
+    {
+        puts("gpio chip not available, use -s for simulated chip");
+        return 1;
+    }
+
+    printf("chip %s (%s), %u iterations\n", gpiox_get_chipname(), gpiox_get_chiplabel(), n);
+
+    bench_all(n);
+
+    if (mem_name != nullptr)
+    {
+        if (!gpiox_mem_init(mem_name))
+        {
+            printf("register file %s failed\n", mem_name);
+            return 1;
+        }
+
+        puts("register backend:");
+
+        bench_all(n);
+
+        gpiox_mem_deinit();
+    }
+
+    return 0;
+}
@@ -0,0 +1,324 @@
+/*
+ * simulated gpio chip for gpiox_set_sys
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * sim_chip.cpp
+ *
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+
+#include <mutex>
+#include <unordered_map>
+
+#include "gpio.h"
+#include "gpiox.h"
+#include "gpiox_int.h"
+#include "sim_chip.h"
+
+#define SIM_CHIPNAME "/dev/gpiochip0"
+#define SIM_LINES 54
+
+// line request of simulated chip
+struct s_request
+{
+    uint32_t num;
+    uint32_t offsets[GPIO_V2_LINES_MAX];
+};
+
+class c_sim_chip
+{
+public:
+    c_sim_chip()
+    {
+        m_chip_fd = -1;
+        m_latency_ns = 0;
+        memset(m_used, 0, sizeof(m_used));
+        memset(m_flags, 0, sizeof(m_flags));
+        memset(m_values, 0, sizeof(m_values));
+    }
+
+    inline void set_latency(uint64_t latency_ns) { m_latency_ns = latency_ns; }
+
+    int open_chip(const char* name, int flags);
+    int close_fd(int fd);
+    int ioctl_fd(int fd, unsigned long request, void* arg);
+
+private:
+    void wait_latency();
+    int chip_ioctl(unsigned long request, void* arg);
+    int line_ioctl(s_request& req, unsigned long request, void* arg);
+    void set_config(s_request& req, const gpio_v2_line_config& config);
+
+    int32_t m_chip_fd;
+    uint64_t m_latency_ns;
+    bool m_used[SIM_LINES];
+    uint64_t m_flags[SIM_LINES];
+    uint32_t m_values[SIM_LINES]; // physical level
+    std::unordered_map<int, s_request> m_requests;
+    std::mutex m_mtx;
+};
+
+// simulates kernel time of ioctl
+void c_sim_chip::wait_latency()
+{
+    if (m_latency_ns == 0)
+        return;
+
+    uint64_t end = get_time_ns() + m_latency_ns;
+
+    while (get_time_ns() < end)
+        ;
+}
+
+int c_sim_chip::open_chip(const char* name, int)
+{
+    if (strcmp(name, SIM_CHIPNAME) != 0)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (m_chip_fd == -1)
+        m_chip_fd = eventfd(0, EFD_CLOEXEC);
+
+    return m_chip_fd;
+}
+
+int c_sim_chip::close_fd(int fd)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    auto it = m_requests.find(fd);
+
+    // releases lines of request
+    if (it != m_requests.end())
+    {
+        for (uint32_t i = 0; i < it->second.num; i++)
+            m_used[it->second.offsets[i]] = false;
+
+        m_requests.erase(it);
+    }
+    else if (fd == m_chip_fd)
+        m_chip_fd = -1;
+
+    return close(fd);
+}
+
+int c_sim_chip::ioctl_fd(int fd, unsigned long request, void* arg)
+{
+    wait_latency();
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (fd == m_chip_fd)
+        return chip_ioctl(request, arg);
+
+    auto it = m_requests.find(fd);
+
+    if (it == m_requests.end())
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    return line_ioctl(it->second, request, arg);
+}
+
+void c_sim_chip::set_config(s_request& req, const gpio_v2_line_config& config)
+{
+    for (uint32_t i = 0; i < req.num; i++)
+    {
+        uint64_t bit = 1ULL << i;
+        uint32_t offset = req.offsets[i];
+
+        m_flags[offset] = config.flags;
+
+        for (uint32_t n = 0; n < config.num_attrs; n++)
+        {
+            const gpio_v2_line_config_attribute& cfg_attr = config.attrs[n];
+
+            if ((cfg_attr.mask & bit) == 0)
+                continue;
+
+            if (cfg_attr.attr.id == GPIO_V2_LINE_ATTR_ID_FLAGS)
+                m_flags[offset] = cfg_attr.attr.flags;
+        }
+
+        for (uint32_t n = 0; n < config.num_attrs; n++)
+        {
+            const gpio_v2_line_config_attribute& cfg_attr = config.attrs[n];
+
+            if (((cfg_attr.mask & bit) == 0) || (cfg_attr.attr.id != GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES))
+                continue;
+
+            uint32_t active = (cfg_attr.attr.values & bit) ? 1 : 0;
+            m_values[offset] = (m_flags[offset] & GPIO_V2_LINE_FLAG_ACTIVE_LOW) ? active ^ 1 : active;
+        }
+    }
+}
+
+int c_sim_chip::chip_ioctl(unsigned long request, void* arg)
+{
+    switch(request)
+    {
+    case GPIO_GET_CHIPINFO_IOCTL:
+    {
+        gpiochip_info* info = static_cast<gpiochip_info*>(arg);
+
+        memset(info, 0, sizeof(*info));
+        strcpy(info->name, "gpiochip0");
+        strcpy(info->label, "sim-gpio");
+        info->lines = SIM_LINES;
+
+        return 0;
+    }
+
+    case GPIO_V2_GET_LINEINFO_IOCTL:
+    {
+        gpio_v2_line_info* info = static_cast<gpio_v2_line_info*>(arg);
+
+        if (info->offset >= SIM_LINES)
+            break;
+
+        snprintf(info->name, sizeof(info->name), "GPIO%u", info->offset);
+        info->flags = m_flags[info->offset] | (m_used[info->offset] ? GPIO_V2_LINE_FLAG_USED : 0);
+
+        return 0;
+    }
+
+    case GPIO_V2_GET_LINE_IOCTL:
+    {
+        gpio_v2_line_request* line_request = static_cast<gpio_v2_line_request*>(arg);
+
+        if ((line_request->num_lines == 0) || (line_request->num_lines > GPIO_V2_LINES_MAX))
+            break;
+
+        s_request req;
+        req.num = line_request->num_lines;
+
+        for (uint32_t i = 0; i < req.num; i++)
+        {
+            req.offsets[i] = line_request->offsets[i];
+
+            if (req.offsets[i] >= SIM_LINES)
+            {
+                errno = EINVAL;
+                return -1;
+            }
+
+            if (m_used[req.offsets[i]])
+            {
+                errno = EBUSY;
+                return -1;
+            }
+        }
+
+        int fd = eventfd(0, EFD_CLOEXEC);
+
+        if (fd == -1)
+            return -1;
+
+        for (uint32_t i = 0; i < req.num; i++)
+            m_used[req.offsets[i]] = true;
+
+        set_config(req, line_request->config);
+
+        m_requests[fd] = req;
+        line_request->fd = fd;
+
+        return 0;
+    }
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+int c_sim_chip::line_ioctl(s_request& req, unsigned long request, void* arg)
+{
+    switch(request)
+    {
+    case GPIO_V2_LINE_SET_CONFIG_IOCTL:
+        set_config(req, *static_cast<gpio_v2_line_config*>(arg));
+        return 0;
+
+    case GPIO_V2_LINE_GET_VALUES_IOCTL:
+    {
+        gpio_v2_line_values* line_values = static_cast<gpio_v2_line_values*>(arg);
+
+        line_values->bits = 0;
+
+        for (uint32_t i = 0; i < req.num; i++)
+        {
+            uint32_t offset = req.offsets[i];
+            uint32_t active = (m_flags[offset] & GPIO_V2_LINE_FLAG_ACTIVE_LOW) ? m_values[offset] ^ 1 : m_values[offset];
+
+            if ((line_values->mask & (1ULL << i)) && active)
+                line_values->bits |= 1ULL << i;
+        }
+
+        return 0;
+    }
+
+    case GPIO_V2_LINE_SET_VALUES_IOCTL:
+    {
+        gpio_v2_line_values* line_values = static_cast<gpio_v2_line_values*>(arg);
+
+        for (uint32_t i = 0; i < req.num; i++)
+        {
+            uint32_t offset = req.offsets[i];
+
+            if ((line_values->mask & (1ULL << i)) == 0)
+                continue;
+
+            if ((m_flags[offset] & GPIO_V2_LINE_FLAG_OUTPUT) == 0)
+            {
+                errno = EPERM;
+                return -1;
+            }
+
+            uint32_t active = (line_values->bits & (1ULL << i)) ? 1 : 0;
+            m_values[offset] = (m_flags[offset] & GPIO_V2_LINE_FLAG_ACTIVE_LOW) ? active ^ 1 : active;
+        }
+
+        return 0;
+    }
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+static c_sim_chip sim_chip;
+
+static int sim_open(const char* name, int flags)
+{
+    return sim_chip.open_chip(name, flags);
+}
+
+static int sim_close(int fd)
+{
+    return sim_chip.close_fd(fd);
+}
+
+static int sim_ioctl(int fd, unsigned long request, void* arg)
+{
+    return sim_chip.ioctl_fd(fd, request, arg);
+}
+
+bool sim_chip_init(uint64_t latency_ns)
+{
+    static const gpiox_sys sim_sys = { sim_open, sim_close, sim_ioctl, read };
+
+    sim_chip.set_latency(latency_ns);
+
+    return gpiox_set_sys(&sim_sys);
+}
@@ -0,0 +1,20 @@
+/*
+ * simulated gpio chip for gpiox_set_sys
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * sim_chip.h
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief installs simulated gpiochip0 with 54 lines as gpiox system calls
+ * @param latency_ns busy wait time in ns of each ioctl
+ * @returns false on error, true on ok
+ * @note line fds are eventfds, outputs are looped back to inputs of same line
+ */
+bool sim_chip_init(uint64_t latency_ns);
@@ -12,15 +12,59 @@
 #include <stdlib.h>
 #include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <string.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
 
 #include "gpio.h"
 #include "gpiox.h"
 #include "gpiox_def.h"
+#include "gpiox_watch.h"
+#include "gpiox_int.h"
+
+//******* system calls
+// chip and line calls can be replaced, e.g. by simulated chip
+
+static int sys_open(const char* name, int flags)
+{
+    return open(name, flags);
+}
+
+static int sys_ioctl(int fd, unsigned long request, void* arg)
+{
+    return ioctl(fd, request, arg);
+}
+
+static const gpiox_sys sys_os = { sys_open, close, sys_ioctl, read };
+static gpiox_sys sys = sys_os;
 
 //******* chip
 // since kernel 6.6.45 all chip address is 0
+// chip 0 is opened on first use, other chips on first line name search
 #define CHIPNAME_CHIP0 "/dev/gpiochip0"
+#define CHIPDIR "/dev"
+#define CHIPPREFIX "gpiochip"
+#define N_CHIP 16
+
+// extended pins for lines found by name on other chips or above N_PIN
+#define N_PIN_EXT 36
+#define N_PIN_ALL (N_PIN + N_PIN_EXT)
 
 class c_chip
 {
@@ -28,234 +72,2219 @@ public:
     c_chip()
     {
         m_fd = -1;
-
-        m_fd = open(CHIPNAME_CHIP0, O_RDWR | O_CLOEXEC);
-
-        if (m_fd != -1)
-        {
-            memset(&m_info, 0, sizeof(m_info));
-
-            if (ioctl(m_fd, GPIO_GET_CHIPINFO_IOCTL, &m_info) == -1)
-            {
-                close(m_fd);
-                m_fd = -1;
-            }
-        }
+        memset(&m_info, 0, sizeof(m_info));
     };
 
     ~c_chip()
     {
         if (m_fd != -1)
-            close(m_fd);
+            sys.close(m_fd);
     };
 
+    bool init(const char* name);
 
     inline int32_t get_fd() { return m_fd; }
     inline const char* get_name() { return m_info.name; }
     inline const char* get_label() { return m_info.label; }
+    inline uint32_t get_lines() { return m_info.lines; }
 
 private:
     int32_t m_fd;
     gpiochip_info m_info;
 };
 
-static c_chip chip;
+bool c_chip::init(const char* name)
+{
+    m_fd = sys.open(name, O_RDWR | O_CLOEXEC);
 
-//******* gpio
+    if (m_fd == -1)
+        return false;
+
+    if (sys.ioctl(m_fd, GPIO_GET_CHIPINFO_IOCTL, &m_info) == -1)
+    {
+        sys.close(m_fd);
+        m_fd = -1;
+        memset(&m_info, 0, sizeof(m_info));
+        return false;
+    }
+
+    return true;
+}
+
+// line of chip
+struct s_line
+{
+    uint32_t chip;   // chip index
+    uint32_t offset; // line offset on chip
+    uint32_t pin;    // pin number, N_PIN_ALL if not assigned
+};
 
-static void set_line_debounce_us(gpio_v2_line_config& line_config, uint32_t debounce_us)
+class c_chips
 {
-    line_config.num_attrs = 1;
-    line_config.attrs[0].mask = 1;
-    line_config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
-    line_config.attrs[0].attr.debounce_period_us = debounce_us;
+public:
+    c_chips()
+    {
+        m_num = 1;
+        m_next_ext = 0;
+    }
+
+    c_chip* get_chip(uint32_t index);
+    bool get_line(uint32_t pin, c_chip*& chip, uint32_t& offset);
+    bool find(const char* name, uint32_t& pin);
+
+private:
+    void scan();
+
+    c_chip m_chip[N_CHIP]; // index 0 is gpiochip0
+    uint32_t m_num;
+    std::once_flag m_chip0_once;
+    std::once_flag m_scan_once;
+    std::unordered_map<std::string, s_line> m_index; // line name to line
+    s_line m_ext[N_PIN_EXT]; // lines of extended pins
+    uint32_t m_next_ext;
+    std::mutex m_mtx;
+};
+
+c_chip* c_chips::get_chip(uint32_t index)
+{
+    std::call_once(m_chip0_once, [this] { m_chip[0].init(CHIPNAME_CHIP0); });
+
+    if (index == 0)
+        return &m_chip[0];
+
+    std::call_once(m_scan_once, [this] { scan(); });
+
+    return (index < m_num) ? &m_chip[index] : nullptr;
 }
 
-static void set_line_value(gpio_v2_line_config& line_config, uint32_t setval)
+// opens all chips and builds line name index
+void c_chips::scan()
 {
-    line_config.num_attrs = 1;
-    line_config.attrs[0].mask = 1;
-    line_config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
-    line_config.attrs[0].attr.values = setval > 0 ? 1 : 0;
+    std::vector<uint32_t> numbers;
+
+    DIR* dir = opendir(CHIPDIR);
+
+    if (dir != nullptr)
+    {
+        dirent* entry;
+
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            if (strncmp(entry->d_name, CHIPPREFIX, strlen(CHIPPREFIX)) != 0)
+                continue;
+
+            char* end;
+            uint32_t number = strtoul(entry->d_name + strlen(CHIPPREFIX), &end, 10);
+
+            if ((*end == 0) && (number != 0))
+                numbers.push_back(number);
+        }
+
+        closedir(dir);
+    }
+
+    std::sort(numbers.begin(), numbers.end());
+
+    for (uint32_t number : numbers)
+    {
+        if (m_num == N_CHIP)
+            break;
+
+        char name[sizeof(CHIPDIR) + sizeof(CHIPPREFIX) + 12];
+        snprintf(name, sizeof(name), CHIPDIR "/" CHIPPREFIX "%u", number);
+
+        if (m_chip[m_num].init(name))
+            m_num++;
+    }
+
+    gpio_v2_line_info line_info;
+
+    for (uint32_t index = 0; index < m_num; index++)
+    {
+        c_chip& chip = m_chip[index];
+
+        for (uint32_t offset = 0; (chip.get_fd() != -1) && (offset < chip.get_lines()); offset++)
+        {
+            memset(&line_info, 0, sizeof(line_info));
+            line_info.offset = offset;
+
+            if ((sys.ioctl(chip.get_fd(), GPIO_V2_GET_LINEINFO_IOCTL, &line_info) == -1) || (line_info.name[0] == 0))
+                continue;
+
+            s_line line;
+            line.chip = index;
+            line.offset = offset;
+            line.pin = ((index == 0) && (offset < N_PIN)) ? offset : N_PIN_ALL;
+
+            // first chip with name wins
+            m_index.emplace(std::string(line_info.name, strnlen(line_info.name, GPIO_MAX_NAME_SIZE)), line);
+        }
+    }
 }
 
-static void set_mode(uint32_t mode, gpio_v2_line_config& line_config, uint32_t setval)
+bool c_chips::get_line(uint32_t pin, c_chip*& chip, uint32_t& offset)
 {
-    switch(mode)
+    if (pin < N_PIN)
     {
-    case GPIO_MODE_INPUT_NOPULL:
-        line_config.flags = GPIO_V2_LINE_FLAG_INPUT + GPIO_V2_LINE_FLAG_BIAS_DISABLED;
-        set_line_debounce_us(line_config, setval);
-        break;
+        chip = get_chip(0);
+        offset = pin;
+        return chip->get_fd() != -1;
+    }
 
-    default:
-    case GPIO_MODE_INPUT_PULLDOWN:
-        line_config.flags = GPIO_V2_LINE_FLAG_INPUT + GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
-        set_line_debounce_us(line_config, setval);
-        break;
+    std::lock_guard<std::mutex> lock(m_mtx);
 
-    case GPIO_MODE_INPUT_PULLUP:
-        line_config.flags = GPIO_V2_LINE_FLAG_INPUT + GPIO_V2_LINE_FLAG_BIAS_PULL_UP + GPIO_V2_LINE_FLAG_ACTIVE_LOW;
-        set_line_debounce_us(line_config, setval);
-        break;
+    if ((pin >= N_PIN_ALL) || (pin - N_PIN >= m_next_ext))
+        return false;
 
-    case GPIO_MODE_OUTPUT:
-        line_config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
-        set_line_value(line_config, setval);
-        break;
+    s_line& line = m_ext[pin - N_PIN];
 
-    case GPIO_MODE_OUTPUT_SOURCE:
-        line_config.flags = GPIO_V2_LINE_FLAG_OUTPUT + GPIO_V2_LINE_FLAG_OPEN_SOURCE;
-        setval = 0;
-        set_line_value(line_config, setval);
-        break;
+    chip = &m_chip[line.chip];
+    offset = line.offset;
 
-    case GPIO_MODE_OUTPUT_SINK:
-        line_config.flags = GPIO_V2_LINE_FLAG_OUTPUT + GPIO_V2_LINE_FLAG_OPEN_DRAIN + GPIO_V2_LINE_FLAG_ACTIVE_LOW;
-        set_line_value(line_config, setval);
-        break;
+    return chip->get_fd() != -1;
+}
+
+bool c_chips::find(const char* name, uint32_t& pin)
+{
+    get_chip(0);
+    std::call_once(m_scan_once, [this] { scan(); });
+
+    auto it = m_index.find(name);
+
+    if (it == m_index.end())
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    s_line& line = it->second;
+
+    // assigns extended pin on first search
+    if (line.pin == N_PIN_ALL)
+    {
+        if (m_next_ext == N_PIN_EXT)
+            return false;
+
+        line.pin = N_PIN + m_next_ext;
+        m_ext[m_next_ext++] = line;
     }
+
+    pin = line.pin;
+
+    return true;
 }
 
-class c_gpio
+static c_chips chips;
+
+//******* gpio register memory
+// register block of BCM2835/BCM2711, mapped from /dev/gpiomem or injected file
+#define GPIOMEM_NAME "/dev/gpiomem"
+#define GPIOMEM_SIZE 4096    // mapped size
+#define GPIOMEM_REGSIZE 0xF4 // size of used registers
+
+// register word offsets
+#define GPFSEL0 (0x00 / 4)
+#define GPSET0 (0x1C / 4)
+#define GPCLR0 (0x28 / 4)
+#define GPLEV0 (0x34 / 4)
+#define GPPUPPDN0 (0xE4 / 4) // BCM2711 pull-up/down
+
+// function select
+#define FSEL_INPUT 0
+#define FSEL_OUTPUT 1
+
+// pull-up/down
+#define PULL_NONE 0
+#define PULL_UP 1
+#define PULL_DOWN 2
+
+class c_gpiomem
 {
 public:
-    c_gpio()
+    c_gpiomem()
     {
-        m_fd = -1;
+        m_reg = nullptr;
+        m_users = 0;
     }
 
-    ~c_gpio()
+    ~c_gpiomem()
     {
         deinit();
     }
 
+    bool init(const char* name);
     void deinit();
-    bool init(uint32_t pin, uint32_t mode, uint32_t setval);
 
-    bool read(uint32_t& val);
-    bool write(uint32_t val);
+    inline bool is_active() { return m_reg.load() != nullptr; }
 
-    inline int32_t get_fd() { return m_fd; }
-    inline void set_fd(int32_t fd) { m_fd = fd; }
+    bool write(uint32_t set_mask, uint32_t clr_mask);
+    bool lev(uint32_t& val);
+
+    void set_fsel(uint32_t pin, uint32_t fsel);
+    void set_pull(uint32_t pin, uint32_t pull);
 
 private:
-    int32_t m_fd;
-};
+    // loads mapping and counts user, returns nullptr if not mapped
+    inline volatile uint32_t* enter()
+    {
+        m_users.fetch_add(1);
 
-void c_gpio::deinit()
-{
-    if (get_fd() != -1)
-        close(get_fd());
+        volatile uint32_t* reg = m_reg.load();
 
-    set_fd(-1);
-}
+        if (reg == nullptr)
+            leave();
 
-bool c_gpio::init(uint32_t pin, uint32_t mode, uint32_t setval)
-{
-    if (chip.get_fd() == -1)
-        return false;
+        return reg;
+    }
 
-    deinit();
+    inline void leave() { m_users.fetch_sub(1, std::memory_order_release); }
 
-    gpio_v2_line_request line_request;
+    std::atomic<volatile uint32_t*> m_reg;
+    std::atomic<uint32_t> m_users; // register accesses in progress
+};
 
-    memset(&line_request, 0, sizeof(line_request));
+bool c_gpiomem::init(const char* name)
+{
+    deinit();
 
-    line_request.num_lines = 1;
-    line_request.offsets[0] = pin;
+    int32_t fd = open((name == nullptr) ? GPIOMEM_NAME : name, O_RDWR | O_SYNC | O_CLOEXEC);
+
+    if (fd == -1)
+        return false;
 
-    set_mode(mode, line_request.config, setval);
+    // injected file must hold all registers
+    struct stat st;
 
-    if (ioctl(chip.get_fd(), GPIO_V2_GET_LINE_IOCTL, &line_request) == -1)
+    if ((fstat(fd, &st) == -1) || (S_ISREG(st.st_mode) && (st.st_size < GPIOMEM_REGSIZE)))
+    {
+        close(fd);
         return false;
+    }
 
-    if (line_request.fd < 0)
+    void* reg = mmap(nullptr, GPIOMEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    // mapping stays valid after close
+    close(fd);
+
+    if (reg == MAP_FAILED)
         return false;
 
-    set_fd(line_request.fd);
+    m_reg = static_cast<volatile uint32_t*>(reg);
 
     return true;
 }
 
-bool c_gpio::read(uint32_t& val)
+// unpublishes mapping and unmaps after all register accesses have left
+void c_gpiomem::deinit()
 {
-    if (get_fd() == -1)
-        return false;
+    volatile uint32_t* reg = m_reg.exchange(nullptr);
 
-    gpio_v2_line_values line_values;
-    line_values.mask = 1;
-    line_values.bits = 0;
+    while (m_users.load() != 0)
+        std::this_thread::yield();
+
+    if (reg != nullptr)
+        munmap((void*) reg, GPIOMEM_SIZE);
+}
 
-    if (ioctl(get_fd(), GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) == -1)
+// sets and clears outputs, false if registers are not mapped
+bool c_gpiomem::write(uint32_t set_mask, uint32_t clr_mask)
+{
+    volatile uint32_t* reg = enter();
+
+    if (reg == nullptr)
         return false;
 
-    val = (line_values.bits == 1) ? 1 : 0;
+    if (set_mask != 0)
+        reg[GPSET0] = set_mask;
+
+    if (clr_mask != 0)
+        reg[GPCLR0] = clr_mask;
+
+    leave();
 
     return true;
 }
 
-bool c_gpio::write(uint32_t val)
+// reads level of all pins, false if registers are not mapped
+bool c_gpiomem::lev(uint32_t& val)
 {
-    if (get_fd() == -1)
+    volatile uint32_t* reg = enter();
+
+    if (reg == nullptr)
         return false;
 
-    gpio_v2_line_values line_values;
-    line_values.mask = 1;
-    line_values.bits = val > 0 ? 1 : 0;
+    val = reg[GPLEV0];
 
-    if (ioctl(get_fd(), GPIO_V2_LINE_SET_VALUES_IOCTL, &line_values) == -1)
-        return false;
+    leave();
 
     return true;
 }
 
-// pin
-#define N_PIN 28
-#define CHECKPIN(p) (p < N_PIN)
+void c_gpiomem::set_fsel(uint32_t pin, uint32_t fsel)
+{
+    volatile uint32_t* reg = enter();
 
-static c_gpio gpio_pin[N_PIN];
+    if (reg == nullptr)
+        return;
 
-const char* gpiox_get_chipname()
+    uint32_t index = GPFSEL0 + pin / 10;
+    uint32_t shift = (pin % 10) * 3;
+
+    reg[index] = (reg[index] & ~(7U << shift)) | (fsel << shift);
+
+    leave();
+}
+
+void c_gpiomem::set_pull(uint32_t pin, uint32_t pull)
 {
-    return chip.get_name();
+    volatile uint32_t* reg = enter();
+
+    if (reg == nullptr)
+        return;
+
+    uint32_t index = GPPUPPDN0 + pin / 16;
+    uint32_t shift = (pin % 16) * 2;
+
+    reg[index] = (reg[index] & ~(3U << shift)) | (pull << shift);
+
+    leave();
 }
 
-const char* gpiox_get_chiplabel()
+static c_gpiomem gpiomem;
+
+//******* gpio
+
+#define N_EVENT_BUFFER_MAX (16 * GPIO_V2_LINES_MAX) // max. kernel event buffer
+
+static std::atomic<uint32_t> event_buffer_size(0); // kernel event buffer of input lines, 0 for default
+static std::atomic<bool> event_clock_realtime(false); // edge event timestamps from CLOCK_REALTIME
+
+static uint64_t get_mode_flags(uint32_t mode)
 {
-    return chip.get_label();
+    switch(mode)
+    {
+    case GPIO_MODE_INPUT_NOPULL:
+        return GPIO_V2_LINE_FLAG_INPUT + GPIO_V2_LINE_FLAG_BIAS_DISABLED;
+
+    default:
+    case GPIO_MODE_INPUT_PULLDOWN:
+        return GPIO_V2_LINE_FLAG_INPUT + GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+
+    case GPIO_MODE_INPUT_PULLUP:
+        return GPIO_V2_LINE_FLAG_INPUT + GPIO_V2_LINE_FLAG_BIAS_PULL_UP + GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+
+    case GPIO_MODE_OUTPUT:
+        return GPIO_V2_LINE_FLAG_OUTPUT;
+
+    case GPIO_MODE_OUTPUT_SOURCE:
+        return GPIO_V2_LINE_FLAG_OUTPUT + GPIO_V2_LINE_FLAG_OPEN_SOURCE;
+
+    case GPIO_MODE_OUTPUT_SINK:
+        return GPIO_V2_LINE_FLAG_OUTPUT + GPIO_V2_LINE_FLAG_OPEN_DRAIN + GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+    }
 }
 
-bool gpiox_init(uint32_t pin, uint32_t mode, uint32_t setval)
+static uint64_t get_edge_flags(uint32_t edge)
 {
-    if (!CHECKPIN(pin))
-        return false;
+    switch(edge)
+    {
+    case GPIO_EDGE_RISING:
+        return GPIO_V2_LINE_FLAG_EDGE_RISING;
 
-    return gpio_pin[pin].init(pin, mode, setval);
+    case GPIO_EDGE_FALLING:
+        return GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+    case GPIO_EDGE_BOTH:
+        return GPIO_V2_LINE_FLAG_EDGE_RISING + GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+    default:
+        return 0;
+    }
 }
 
-bool gpiox_deinit(uint32_t pin)
+static bool is_output_mode(uint32_t mode)
 {
-    if (!CHECKPIN(pin))
+    return (mode == GPIO_MODE_OUTPUT) || (mode == GPIO_MODE_OUTPUT_SOURCE) || (mode == GPIO_MODE_OUTPUT_SINK);
+}
+
+// adds line bit to matching attribute or appends new attribute
+static bool add_line_attr(gpio_v2_line_config& line_config, uint32_t id, uint64_t val, uint64_t bit)
+{
+    for (uint32_t i = 0; i < line_config.num_attrs; i++)
+    {
+        gpio_v2_line_config_attribute& cfg_attr = line_config.attrs[i];
+
+        if (cfg_attr.attr.id != id)
+            continue;
+
+        // one output values attribute holds all output lines
+        if (id == GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES)
+        {
+            cfg_attr.mask |= bit;
+
+            if (val > 0)
+                cfg_attr.attr.values |= bit;
+
+            return true;
+        }
+
+        if (((id == GPIO_V2_LINE_ATTR_ID_FLAGS) && (cfg_attr.attr.flags == val)) ||
+            ((id == GPIO_V2_LINE_ATTR_ID_DEBOUNCE) && (cfg_attr.attr.debounce_period_us == val)))
+        {
+            cfg_attr.mask |= bit;
+            return true;
+        }
+    }
+
+    if (line_config.num_attrs == GPIO_V2_LINE_NUM_ATTRS_MAX)
         return false;
 
-    gpio_pin[pin].deinit();
+    gpio_v2_line_config_attribute& cfg_attr = line_config.attrs[line_config.num_attrs++];
+
+    cfg_attr.mask = bit;
+    cfg_attr.attr.id = id;
+
+    switch(id)
+    {
+    case GPIO_V2_LINE_ATTR_ID_FLAGS:
+        cfg_attr.attr.flags = val;
+        break;
+
+    case GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES:
+        cfg_attr.attr.values = (val > 0) ? bit : 0;
+        break;
+
+    case GPIO_V2_LINE_ATTR_ID_DEBOUNCE:
+        cfg_attr.attr.debounce_period_us = val;
+        break;
+    }
 
     return true;
 }
 
-bool gpiox_read(uint32_t pin, uint32_t& val)
+// sets mode of line index in line config, lines must be set in index order
+static bool set_line_mode(gpio_v2_line_config& line_config, uint32_t index, uint32_t mode, uint32_t setval)
 {
-    if (!CHECKPIN(pin))
+    uint64_t bit = 1ULL << index;
+    uint64_t flags = get_mode_flags(mode);
+
+    // first line sets default flags, other lines with other flags needs attribute
+    if (index == 0)
+        line_config.flags = flags;
+    else if ((flags != line_config.flags) && !add_line_attr(line_config, GPIO_V2_LINE_ATTR_ID_FLAGS, flags, bit))
         return false;
 
-    return gpio_pin[pin].read(val);
+    if (is_output_mode(mode))
+    {
+        if (mode == GPIO_MODE_OUTPUT_SOURCE)
+            setval = 0;
+
+        return add_line_attr(line_config, GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES, setval, bit);
+    }
+
+    // debounce 0 is disabled
+    if (setval > 0)
+        return add_line_attr(line_config, GPIO_V2_LINE_ATTR_ID_DEBOUNCE, setval, bit);
+
+    return true;
 }
 
-bool gpiox_write(uint32_t pin, uint32_t val)
+//******* lock-free line access
+// readers and writers count as users and loads access once,
+// setup publishes new access and closes old fd after all users have left
+
+// setup lock of one pin or group, never held by readers and writers
+class c_setup_lock
 {
-    if (!CHECKPIN(pin))
-        return false;
+public:
+    inline void lock()
+    {
+        while (m_flag.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
 
-    return gpio_pin[pin].write(val);
+    inline void unlock()
+    {
+        m_flag.clear(std::memory_order_release);
+    }
+
+private:
+    std::atomic_flag m_flag = ATOMIC_FLAG_INIT;
+};
+
+// counts user while in scope
+class c_user
+{
+public:
+    c_user(std::atomic<uint32_t>& users) : m_users(users)
+    {
+        m_users.fetch_add(1);
+    }
+
+    ~c_user()
+    {
+        m_users.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    std::atomic<uint32_t>& m_users;
+};
+
+// closes fd after all users have left
+static void close_deferred(int32_t fd, std::atomic<uint32_t>& users)
+{
+    while (users.load() != 0)
+        std::this_thread::yield();
+
+    if (fd != -1)
+        sys.close(fd);
+}
+
+// access of pin, loaded by readers and writers with one atomic load
+struct s_access
+{
+    int32_t fd;     // line request fd, -1 if not requested
+    uint8_t mem;    // 1 on register access
+    uint8_t shift;  // register bit number
+    uint8_t invert; // 1 on active low
+    uint8_t output; // 1 on output
+};
+
+static const s_access no_access = { -1, 0, 0, 0, 0 };
+
+// own cache line for each pin, pins never share state
+class alignas(64) c_gpio
+{
+public:
+    c_gpio()
+    {
+        m_access = no_access;
+        m_users = 0;
+        m_gen = 0;
+        m_claimed = false;
+        m_mode = GPIO_MODE_INPUT_PULLDOWN;
+        m_setval = 0;
+    }
+
+    ~c_gpio()
+    {
+        std::lock_guard<c_setup_lock> lock(m_setup);
+
+        release();
+    }
+
+    bool deinit();
+    bool claim(uint32_t gen);
+    void unclaim() { m_claimed = false; }
+    bool init(uint32_t pin, uint32_t mode, uint32_t setval);
+    bool reconfigure(uint32_t pin, uint32_t mode, uint32_t setval);
+    bool set_edge(uint32_t pin, uint32_t edge, uint32_t debounce_us);
+    void drop_mem();
+
+    bool read(uint32_t& val);
+    bool read(uint32_t& val, const uint32_t* lev);
+    bool write(uint32_t val);
+
+    inline int32_t get_fd() { return m_access.load().fd; }
+    inline uint32_t get_gen() { return m_gen.load(); }
+    inline bool is_claimed() { return m_claimed.load(); }
+    inline uint32_t get_bit() { s_access access = m_access.load(); return access.mem ? 1U << access.shift : 0; }
+    inline bool is_output() { s_access access = m_access.load(); return access.output && ((access.fd != -1) || access.mem); }
+
+private:
+    void release();
+    bool init_mem(uint32_t pin, uint32_t mode, uint32_t setval);
+    void publish(int32_t fd, uint32_t pin, uint32_t mode, uint32_t setval);
+
+    std::atomic<s_access> m_access;
+    std::atomic<uint32_t> m_users; // readers and writers in progress
+    std::atomic<uint32_t> m_gen;   // incremented on each init and deinit
+    std::atomic<bool> m_claimed;   // line owned by handle, init and deinit fails
+    c_setup_lock m_setup;
+    uint32_t m_mode;   // mode of init, setup lock
+    uint32_t m_setval; // setval of init, setup lock
+};
+
+// unpublishes access and closes fd, setup lock must be held
+void c_gpio::release()
+{
+    s_access access = m_access.exchange(no_access);
+
+    m_gen++;
+
+    close_deferred(access.fd, m_users);
+}
+
+bool c_gpio::deinit()
+{
+    std::lock_guard<c_setup_lock> lock(m_setup);
+
+    if (m_claimed)
+        return false;
+
+    release();
+
+    return true;
+}
+
+// claims requested line of generation, fd stays valid until unclaim
+bool c_gpio::claim(uint32_t gen)
+{
+    std::lock_guard<c_setup_lock> lock(m_setup);
+
+    if (m_claimed || (m_access.load().fd == -1) || (m_gen != gen))
+        return false;
+
+    m_claimed = true;
+
+    return true;
+}
+
+// publishes access, selects register access for modes without kernel emulation
+void c_gpio::publish(int32_t fd, uint32_t pin, uint32_t mode, uint32_t setval)
+{
+    s_access access = no_access;
+
+    access.fd = fd;
+    access.invert = (mode == GPIO_MODE_INPUT_PULLUP) ? 1 : 0;
+    access.output = is_output_mode(mode) ? 1 : 0;
+    access.shift = pin;
+
+    // open source/drain and debounce are done in kernel
+    if (gpiomem.is_active() && (pin < N_PIN) && ((mode == GPIO_MODE_OUTPUT) || (!access.output && (setval == 0))))
+        access.mem = 1;
+
+    m_access.store(access);
+}
+
+// sets pin by registers if chip is not available, setup lock must be held
+bool c_gpio::init_mem(uint32_t pin, uint32_t mode, uint32_t setval)
+{
+    if (!gpiomem.is_active() || ((mode != GPIO_MODE_OUTPUT) && (is_output_mode(mode) || (setval != 0))))
+        return false;
+
+    if (mode == GPIO_MODE_OUTPUT)
+    {
+        if (setval > 0)
+            gpiomem.write(1U << pin, 0);
+        else
+            gpiomem.write(0, 1U << pin);
+
+        gpiomem.set_fsel(pin, FSEL_OUTPUT);
+    }
+    else
+    {
+        gpiomem.set_pull(pin, (mode == GPIO_MODE_INPUT_PULLUP) ? PULL_UP : (mode == GPIO_MODE_INPUT_NOPULL) ? PULL_NONE : PULL_DOWN);
+        gpiomem.set_fsel(pin, FSEL_INPUT);
+    }
+
+    publish(-1, pin, mode, setval);
+    m_gen++;
+
+    return true;
+}
+
+void c_gpio::drop_mem()
+{
+    std::lock_guard<c_setup_lock> lock(m_setup);
+
+    s_access access = m_access.load();
+
+    if (!access.mem)
+        return;
+
+    // pin without line request is not usable without registers
+    if (access.fd == -1)
+    {
+        release();
+        return;
+    }
+
+    access.mem = 0;
+    m_access.store(access);
+
+    // readers and writers with register access have left before registers are unmapped
+    while (m_users.load() != 0)
+        std::this_thread::yield();
+}
+
+bool c_gpio::init(uint32_t pin, uint32_t mode, uint32_t setval)
+{
+    std::lock_guard<c_setup_lock> lock(m_setup);
+
+    if (m_claimed)
+        return false;
+
+    release();
+
+    m_mode = mode;
+    m_setval = setval;
+
+    c_chip* chip;
+    uint32_t offset;
+
+    if (!chips.get_line(pin, chip, offset))
+        return (pin < N_PIN) ? init_mem(pin, mode, setval) : false;
+
+    gpio_v2_line_request line_request;
+
+    memset(&line_request, 0, sizeof(line_request));
+
+    line_request.num_lines = 1;
+    line_request.offsets[0] = offset;
+
+    if (!is_output_mode(mode))
+        line_request.event_buffer_size = event_buffer_size;
+
+    set_line_mode(line_request.config, 0, mode, setval);
+
+    if (sys.ioctl(chip->get_fd(), GPIO_V2_GET_LINE_IOCTL, &line_request) == -1)
+        return false;
+
+    if (line_request.fd < 0)
+        return false;
+
+    publish(line_request.fd, pin, mode, setval);
+    m_gen++;
+
+    return true;
+}
+
+bool c_gpio::reconfigure(uint32_t pin, uint32_t mode, uint32_t setval)
+{
+    {
+        std::lock_guard<c_setup_lock> lock(m_setup);
+
+        if (m_claimed)
+            return false;
+
+        int32_t fd = m_access.load().fd;
+
+        // change config on requested line, line stays owned
+        if (fd != -1)
+        {
+            gpio_v2_line_config line_config;
+
+            memset(&line_config, 0, sizeof(line_config));
+
+            set_line_mode(line_config, 0, mode, setval);
+
+            if (sys.ioctl(fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &line_config) == -1)
+                return false;
+
+            publish(fd, pin, mode, setval);
+            m_mode = mode;
+            m_setval = setval;
+
+            return true;
+        }
+    }
+
+    // line not requested
+    return init(pin, mode, setval);
+}
+
+// sets edge detection on requested input line, GPIO_EDGE_NONE restores init config
+bool c_gpio::set_edge(uint32_t pin, uint32_t edge, uint32_t debounce_us)
+{
+    std::lock_guard<c_setup_lock> lock(m_setup);
+
+    s_access access = m_access.load();
+
+    if ((access.fd == -1) || access.output)
+        return false;
+
+    if (edge == GPIO_EDGE_NONE)
+        debounce_us = m_setval;
+
+    gpio_v2_line_config line_config;
+
+    memset(&line_config, 0, sizeof(line_config));
+
+    set_line_mode(line_config, 0, m_mode, debounce_us);
+    line_config.flags |= get_edge_flags(edge);
+
+    if ((edge != GPIO_EDGE_NONE) && event_clock_realtime)
+        line_config.flags |= GPIO_V2_LINE_FLAG_EVENT_CLOCK_REALTIME;
+
+    if (sys.ioctl(access.fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &line_config) == -1)
+        return false;
+
+    publish(access.fd, pin, m_mode, debounce_us);
+
+    return true;
+}
+
+// reads value from line request
+static bool read_line(const s_access& access, uint32_t& val)
+{
+    if (access.fd == -1)
+        return false;
+
+    gpio_v2_line_values line_values;
+    line_values.mask = 1;
+    line_values.bits = 0;
+
+    if (sys.ioctl(access.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) == -1)
+        return false;
+
+    val = (line_values.bits == 1) ? 1 : 0;
+
+    return true;
+}
+
+bool c_gpio::read(uint32_t& val)
+{
+    c_user user(m_users);
+
+    s_access access = m_access.load();
+    uint32_t lev;
+
+    // line request if registers are unmapped meanwhile
+    if (access.mem && gpiomem.lev(lev))
+    {
+        val = ((lev >> access.shift) & 1) ^ access.invert;
+        return true;
+    }
+
+    return read_line(access, val);
+}
+
+// reads with register level read before, lev is nullptr if registers are not mapped
+bool c_gpio::read(uint32_t& val, const uint32_t* lev)
+{
+    c_user user(m_users);
+
+    s_access access = m_access.load();
+
+    if (access.mem)
+    {
+        if (lev != nullptr)
+        {
+            val = ((*lev >> access.shift) & 1) ^ access.invert;
+            return true;
+        }
+
+        uint32_t reg_lev;
+
+        // mapped after level read of caller
+        if (gpiomem.lev(reg_lev))
+        {
+            val = ((reg_lev >> access.shift) & 1) ^ access.invert;
+            return true;
+        }
+    }
+
+    return read_line(access, val);
+}
+
+bool c_gpio::write(uint32_t val)
+{
+    c_user user(m_users);
+
+    s_access access = m_access.load();
+
+    if (access.mem)
+    {
+        if (!access.output)
+            return false;
+
+        if ((val > 0) ? gpiomem.write(1U << access.shift, 0) : gpiomem.write(0, 1U << access.shift))
+            return true;
+    }
+
+    if (access.fd == -1)
+        return false;
+
+    gpio_v2_line_values line_values;
+    line_values.mask = 1;
+    line_values.bits = val > 0 ? 1 : 0;
+
+    if (sys.ioctl(access.fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &line_values) == -1)
+        return false;
+
+    return true;
+}
+
+//******* group of lines
+
+class alignas(64) c_group
+{
+public:
+    c_group()
+    {
+        m_fd = -1;
+        m_mask = 0;
+        m_users = 0;
+    }
+
+    ~c_group()
+    {
+        deinit();
+    }
+
+    void deinit();
+    bool init(const uint32_t* pins, const uint32_t* modes, const uint32_t* setvals, uint32_t num);
+
+    bool read(uint64_t& bits);
+    bool write(uint64_t mask, uint64_t bits);
+
+    inline int32_t get_fd() { return m_fd.load(); }
+
+private:
+    void release();
+
+    std::atomic<int32_t> m_fd;
+    std::atomic<uint64_t> m_mask; // mask of all lines in group
+    std::atomic<uint32_t> m_users; // readers and writers in progress
+    c_setup_lock m_setup;
+};
+
+// unpublishes fd and closes it, setup lock must be held
+void c_group::release()
+{
+    m_mask = 0;
+
+    close_deferred(m_fd.exchange(-1), m_users);
+}
+
+void c_group::deinit()
+{
+    std::lock_guard<c_setup_lock> lock(m_setup);
+
+    release();
+}
+
+bool c_group::init(const uint32_t* pins, const uint32_t* modes, const uint32_t* setvals, uint32_t num)
+{
+    if ((num == 0) || (num > GPIO_V2_LINES_MAX))
+        return false;
+
+    std::lock_guard<c_setup_lock> lock(m_setup);
+
+    release();
+
+    gpio_v2_line_request line_request;
+
+    memset(&line_request, 0, sizeof(line_request));
+
+    line_request.num_lines = num;
+
+    c_chip* group_chip = nullptr;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        c_chip* chip;
+
+        if (!chips.get_line(pins[i], chip, line_request.offsets[i]))
+            return false;
+
+        // all lines must be on same chip
+        if ((group_chip != nullptr) && (chip != group_chip))
+            return false;
+
+        group_chip = chip;
+
+        // modes which differ from first line are set by attribute mask
+        if (!set_line_mode(line_request.config, i, modes[i], setvals[i]))
+            return false;
+    }
+
+    if (sys.ioctl(group_chip->get_fd(), GPIO_V2_GET_LINE_IOCTL, &line_request) == -1)
+        return false;
+
+    if (line_request.fd < 0)
+        return false;
+
+    m_mask = (num == GPIO_V2_LINES_MAX) ? ~0ULL : (1ULL << num) - 1;
+    m_fd = line_request.fd;
+
+    return true;
+}
+
+bool c_group::read(uint64_t& bits)
+{
+    c_user user(m_users);
+
+    int32_t fd = m_fd.load();
+
+    if (fd == -1)
+        return false;
+
+    gpio_v2_line_values line_values;
+    line_values.mask = m_mask.load(std::memory_order_relaxed);
+    line_values.bits = 0;
+
+    if (sys.ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) == -1)
+        return false;
+
+    bits = line_values.bits;
+
+    return true;
+}
+
+bool c_group::write(uint64_t mask, uint64_t bits)
+{
+    c_user user(m_users);
+
+    int32_t fd = m_fd.load();
+
+    if (fd == -1)
+        return false;
+
+    gpio_v2_line_values line_values;
+    line_values.mask = mask & m_mask.load(std::memory_order_relaxed);
+    line_values.bits = bits & line_values.mask;
+
+    if (line_values.mask == 0)
+        return true;
+
+    if (sys.ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &line_values) == -1)
+        return false;
+
+    return true;
+}
+
+// pin
+#define CHECKPIN(p) (p < N_PIN)      // header pins
+#define CHECKLINE(p) (p < N_PIN_ALL) // header and extended pins
+
+static c_gpio gpio_pin[N_PIN_ALL];
+
+// state cache of watched header pins, fed by edge events of watch
+// low word holds state, high word marks cached pins, both are updated together
+static std::atomic<uint64_t> cache_state(0);
+static std::atomic<uint64_t> cache_ns[N_PIN]; // timestamp of last state change
+
+#define CACHE_BITS(p) ((1ULL | (1ULL << 32)) << p)
+
+static void cache_clear(uint32_t pin)
+{
+    if (CHECKPIN(pin))
+        cache_state.fetch_and(~CACHE_BITS(pin));
+}
+
+static bool cache_read(uint32_t pin, uint32_t& val)
+{
+    uint64_t state = cache_state.load();
+
+    if (!CHECKPIN(pin) || (((state >> 32) >> pin) & 1) == 0)
+        return false;
+
+    val = (state >> pin) & 1;
+
+    return true;
+}
+
+// group
+#define N_GROUP 8
+#define CHECKGROUP(g) (g < N_GROUP)
+
+static c_group gpio_group[N_GROUP];
+
+// writes mapped outputs together, each pin by its line request if registers are unmapped meanwhile
+static bool write_bits(uint32_t set_mask, uint32_t clr_mask)
+{
+    if (gpiomem.write(set_mask, clr_mask))
+        return true;
+
+    bool ret = true;
+
+    for (uint32_t pin = 0; pin < N_PIN; pin++)
+    {
+        if (((set_mask | clr_mask) & (1U << pin)) && !gpio_pin[pin].write((set_mask >> pin) & 1))
+            ret = false;
+    }
+
+    return ret;
+}
+
+//******* blink and pwm
+// one thread toggles all blinking and pwm pins, next edge times are kept in min-heap
+// pins with same period toggles in same wakeup and stays in phase
+
+struct s_blink
+{
+    uint64_t deadline; // next edge time in ns
+    uint64_t period;   // period in ns
+    uint64_t high;     // high time in ns, blink is half period
+    uint32_t pin;
+    uint32_t state;
+};
+
+// pwm of group channels, heap entry of group has pin N_PIN + group
+struct s_group_pwm
+{
+    uint64_t high[GPIO_V2_LINES_MAX]; // high time in ns of channel n, pins[n] of group
+    uint64_t mask; // mask of channels
+};
+
+#define BLINK_GROUP(g) (N_PIN + g)
+
+// sets state and next edge from clock, phase of period starts with high
+static void blink_next(s_blink& blink, uint64_t now)
+{
+    uint64_t phase = now % blink.period;
+
+    blink.state = (phase < blink.high) ? 1 : 0;
+    blink.deadline = now - phase + (blink.state ? blink.high : blink.period);
+}
+
+// min-heap order
+static bool blink_later(const s_blink& a, const s_blink& b)
+{
+    return a.deadline > b.deadline;
+}
+
+class c_blink
+{
+public:
+    c_blink()
+    {
+        m_tfd = -1;
+        m_efd = -1;
+        m_pins = 0;
+        m_groups = 0;
+        m_realtime = 0;
+
+        memset(m_group, 0, sizeof(m_group));
+    }
+
+    ~c_blink()
+    {
+        deinit();
+    }
+
+    bool start(uint32_t pin, uint64_t period_ns, uint64_t high_ns, bool realtime);
+    void stop(uint32_t pin);
+    bool start_group(uint32_t group, uint64_t period_ns, const uint64_t* high_ns, uint32_t num, bool realtime);
+    void stop_group(uint32_t group);
+
+    inline bool is_blink(uint32_t pin) { return (pin < N_PIN) && ((m_pins.load() & (1U << pin)) != 0); }
+    inline bool is_group(uint32_t group) { return (m_groups.load() & (1U << group)) != 0; }
+    inline uint64_t get_group_mask(uint32_t group) { return m_group[group].mask; }
+
+private:
+    bool init();
+    void deinit();
+    void loop();
+    void set_timer();
+    void set_sched();
+    void push(const s_blink& blink, bool realtime);
+    void remove(uint32_t id);
+    uint64_t group_next(s_blink& blink, uint64_t now);
+
+    int32_t m_tfd; // timer
+    int32_t m_efd; // stop event
+    std::atomic<uint32_t> m_pins; // mask of blinking pins
+    std::atomic<uint32_t> m_groups; // mask of groups with pwm
+    uint64_t m_realtime; // mask of pins and groups requesting realtime thread
+    s_group_pwm m_group[N_GROUP];
+    std::vector<s_blink> m_heap;
+    std::mutex m_mtx;
+    std::thread m_thread;
+};
+
+bool c_blink::init()
+{
+    if (m_thread.joinable())
+        return true;
+
+    m_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    m_efd = eventfd(0, EFD_CLOEXEC);
+
+    if ((m_tfd == -1) || (m_efd == -1))
+    {
+        deinit();
+        return false;
+    }
+
+    m_thread = std::thread(&c_blink::loop, this);
+
+    return true;
+}
+
+void c_blink::deinit()
+{
+    if (m_thread.joinable())
+    {
+        uint64_t val = 1;
+
+        if (write(m_efd, &val, sizeof(val)) == sizeof(val))
+            m_thread.join();
+        else
+            m_thread.detach();
+    }
+
+    if (m_tfd != -1)
+        close(m_tfd);
+
+    if (m_efd != -1)
+        close(m_efd);
+
+    m_tfd = -1;
+    m_efd = -1;
+}
+
+// arms timer on earliest toggle, lock must be held
+void c_blink::set_timer()
+{
+    itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+
+    if (!m_heap.empty())
+    {
+        uint64_t deadline = m_heap.front().deadline;
+
+        its.it_value.tv_sec = deadline / NS_PER_S;
+        its.it_value.tv_nsec = deadline % NS_PER_S;
+    }
+
+    timerfd_settime(m_tfd, TFD_TIMER_ABSTIME, &its, nullptr);
+}
+
+// thread runs with SCHED_FIFO while any pin requests realtime, lock must be held
+void c_blink::set_sched()
+{
+    if (!m_thread.joinable())
+        return;
+
+    sched_param param;
+    param.sched_priority = (m_realtime != 0) ? sched_get_priority_max(SCHED_FIFO) : 0;
+
+    pthread_setschedparam(m_thread.native_handle(), (m_realtime != 0) ? SCHED_FIFO : SCHED_OTHER, &param);
+}
+
+bool c_blink::start(uint32_t pin, uint64_t period_ns, uint64_t high_ns, bool realtime)
+{
+    s_blink blink;
+
+    blink.pin = pin;
+    blink.period = (period_ns < 2) ? 2 : period_ns;
+    blink.high = (high_ns == 0) ? 1 : high_ns;
+
+    // state and deadline depends only on clock, so pins with same period are in phase
+    blink_next(blink, get_time_ns());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        if (!init())
+            return false;
+
+        // old entry stops toggling before first write
+        if (m_pins & (1U << pin))
+        {
+            m_pins &= ~(1U << pin);
+            remove(pin);
+        }
+    }
+
+    // first write without lock, thread is not delayed by ioctl
+    if (!gpio_pin[pin].write(blink.state))
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_pins |= 1U << pin;
+
+    push(blink, realtime);
+
+    return true;
+}
+
+// adds entry to heap and rearms timer, lock must be held
+// replaces entry of same pin or group, concurrent starts leaves one entry
+void c_blink::push(const s_blink& blink, bool realtime)
+{
+    uint32_t id = blink.pin;
+
+    m_heap.erase(std::remove_if(m_heap.begin(), m_heap.end(), [id](const s_blink& entry) { return entry.pin == id; }), m_heap.end());
+    m_heap.push_back(blink);
+    std::make_heap(m_heap.begin(), m_heap.end(), blink_later);
+
+    if (((m_realtime >> id) & 1) != (realtime ? 1U : 0U))
+    {
+        m_realtime ^= 1ULL << id;
+        set_sched();
+    }
+
+    set_timer();
+}
+
+// sets bits of group channels and next edge from clock
+// all channels switches on at start of period, channels with same high time switches off together
+uint64_t c_blink::group_next(s_blink& blink, uint64_t now)
+{
+    const s_group_pwm& pwm = m_group[blink.pin - N_PIN];
+    uint64_t phase = now % blink.period;
+    uint64_t next = blink.period;
+    uint64_t bits = 0;
+
+    for (uint32_t i = 0; i < GPIO_V2_LINES_MAX; i++)
+    {
+        if (phase < pwm.high[i])
+        {
+            bits |= 1ULL << i;
+
+            if (pwm.high[i] < next)
+                next = pwm.high[i];
+        }
+    }
+
+    blink.deadline = now - phase + next;
+
+    return bits;
+}
+
+bool c_blink::start_group(uint32_t group, uint64_t period_ns, const uint64_t* high_ns, uint32_t num, bool realtime)
+{
+    s_blink blink;
+    uint64_t mask;
+    uint64_t bits;
+    bool toggle = false;
+
+    blink.pin = BLINK_GROUP(group);
+    blink.period = period_ns;
+    blink.high = 0;
+    blink.state = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        if (!init())
+            return false;
+
+        // old entry stops toggling before channels are changed
+        if (m_groups & (1U << group))
+        {
+            m_groups &= ~(1U << group);
+            remove(BLINK_GROUP(group));
+        }
+
+        s_group_pwm& pwm = m_group[group];
+
+        memset(&pwm, 0, sizeof(pwm));
+
+        for (uint32_t i = 0; i < num; i++)
+        {
+            pwm.high[i] = high_ns[i];
+            toggle |= (high_ns[i] > 0) && (high_ns[i] < period_ns);
+        }
+
+        pwm.mask = (num == GPIO_V2_LINES_MAX) ? ~0ULL : (1ULL << num) - 1;
+        mask = pwm.mask;
+
+        // channels in phase with other groups and pins of same period
+        bits = group_next(blink, get_time_ns());
+    }
+
+    // first write without lock, thread is not delayed by ioctl
+    if (!gpio_group[group].write(mask, bits))
+        return false;
+
+    // only 0% and 100% channels, output is steady
+    if (!toggle)
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_groups |= 1U << group;
+
+    push(blink, realtime);
+
+    return true;
+}
+
+void c_blink::stop(uint32_t pin)
+{
+    if (!is_blink(pin))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_pins &= ~(1U << pin);
+
+    remove(pin);
+}
+
+void c_blink::stop_group(uint32_t group)
+{
+    if (!is_group(group))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_groups &= ~(1U << group);
+
+    remove(BLINK_GROUP(group));
+}
+
+// removes entry of pin or group from heap, lock must be held
+void c_blink::remove(uint32_t id)
+{
+    m_heap.erase(std::remove_if(m_heap.begin(), m_heap.end(), [id](const s_blink& blink) { return blink.pin == id; }), m_heap.end());
+    std::make_heap(m_heap.begin(), m_heap.end(), blink_later);
+
+    if (m_realtime & (1ULL << id))
+    {
+        m_realtime &= ~(1ULL << id);
+        set_sched();
+    }
+
+    set_timer();
+}
+
+void c_blink::loop()
+{
+    pollfd fds[2];
+
+    fds[0].fd = m_tfd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_efd;
+    fds[1].events = POLLIN;
+
+    // timer expires without default slack of 50us
+    prctl(PR_SET_TIMERSLACK, 1);
+
+    while (true)
+    {
+        if (poll(fds, 2, -1) == -1)
+            continue;
+
+        if (fds[1].revents & POLLIN)
+            break;
+
+        uint64_t expired;
+
+        if (read(m_tfd, &expired, sizeof(expired)) != sizeof(expired))
+            continue;
+
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        uint64_t now = get_time_ns();
+        uint32_t set_mask = 0;
+        uint32_t clr_mask = 0;
+
+        // toggles all due pins
+        while (!m_heap.empty() && (m_heap.front().deadline <= now))
+        {
+            std::pop_heap(m_heap.begin(), m_heap.end(), blink_later);
+            s_blink& blink = m_heap.back();
+
+            // group channels are written with one ioctl
+            if (blink.pin >= N_PIN)
+            {
+                uint32_t group = blink.pin - N_PIN;
+                uint64_t bits = group_next(blink, now);
+
+                gpio_group[group].write(m_group[group].mask, bits);
+
+                std::push_heap(m_heap.begin(), m_heap.end(), blink_later);
+                continue;
+            }
+
+            // state from clock, also after missed edges
+            blink_next(blink, now);
+
+            uint32_t bit = gpio_pin[blink.pin].get_bit();
+
+            // register pins are written together
+            if (bit != 0)
+            {
+                if (blink.state)
+                    set_mask |= bit;
+                else
+                    clr_mask |= bit;
+            }
+            else
+                gpio_pin[blink.pin].write(blink.state);
+
+            std::push_heap(m_heap.begin(), m_heap.end(), blink_later);
+        }
+
+        if ((set_mask | clr_mask) != 0)
+            write_bits(set_mask, clr_mask);
+
+        set_timer();
+    }
+}
+
+static c_blink blink;
+
+//******* wave
+// plays steps of bitmaps on group outputs from own thread, one ioctl per step
+
+#define WAVE_SLEEP_MAX_NS (100 * NS_PER_MS) // max. sleep for check of stop
+
+class c_wave
+{
+public:
+    c_wave()
+    {
+        m_run = false;
+        clear_stat();
+    }
+
+    ~c_wave()
+    {
+        stop();
+    }
+
+    bool start(uint32_t group, const gpiox_step* steps, uint32_t num, uint64_t mask, bool loop, bool realtime);
+    void stop();
+    void get_stat(gpiox_wave_stat& wave_stat);
+
+private:
+    void clear_stat();
+    void play(uint32_t group, uint64_t mask, bool loop, bool realtime);
+
+    std::vector<gpiox_step> m_steps;
+    std::atomic<bool> m_run;
+    std::atomic<uint64_t> m_nstep;
+    std::atomic<uint64_t> m_nloop;
+    std::atomic<uint64_t> m_underrun;
+    std::atomic<uint64_t> m_error;
+    std::atomic<uint64_t> m_late_max;
+    std::atomic<uint64_t> m_late_sum;
+    std::mutex m_mtx; // start and stop
+    std::thread m_thread;
+};
+
+void c_wave::clear_stat()
+{
+    m_nstep = 0;
+    m_nloop = 0;
+    m_underrun = 0;
+    m_error = 0;
+    m_late_max = 0;
+    m_late_sum = 0;
+}
+
+bool c_wave::start(uint32_t group, const gpiox_step* steps, uint32_t num, uint64_t mask, bool loop, bool realtime)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    // player thread is joined before steps are replaced
+    m_run = false;
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if ((steps == nullptr) || (num == 0))
+        return false;
+
+    m_steps.assign(steps, steps + num);
+    clear_stat();
+
+    m_run = true;
+    m_thread = std::thread(&c_wave::play, this, group, mask, loop, realtime);
+
+    return true;
+}
+
+void c_wave::stop()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_run = false;
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void c_wave::get_stat(gpiox_wave_stat& wave_stat)
+{
+    wave_stat.running = m_run;
+    wave_stat.steps = m_nstep;
+    wave_stat.loops = m_nloop;
+    wave_stat.underruns = m_underrun;
+    wave_stat.errors = m_error;
+    wave_stat.late_max_ns = m_late_max;
+    wave_stat.late_mean_ns = (wave_stat.steps > 0) ? m_late_sum / wave_stat.steps : 0;
+}
+
+void c_wave::play(uint32_t group, uint64_t mask, bool loop, bool realtime)
+{
+    if (realtime)
+    {
+        sched_param param;
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+
+    uint64_t deadline = get_time_ns();
+
+    do
+    {
+        for (const gpiox_step& step : m_steps)
+        {
+            deadline += step.delta_ns;
+
+            uint64_t now = get_time_ns();
+
+            // step is due before player is ready
+            if (now > deadline)
+                m_underrun++;
+
+            while (m_run && (now < deadline))
+            {
+                uint64_t wake = std::min(deadline, now + WAVE_SLEEP_MAX_NS);
+
+                timespec ts;
+                ts.tv_sec = wake / NS_PER_S;
+                ts.tv_nsec = wake % NS_PER_S;
+
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+                now = get_time_ns();
+            }
+
+            if (!m_run)
+                return;
+
+            // player keeps timing on error, failed steps are counted
+            if (!gpio_group[group].write(mask, step.bits))
+                m_error++;
+
+            uint64_t late = now - deadline;
+
+            m_late_sum += late;
+
+            if (late > m_late_max)
+                m_late_max = late;
+
+            m_nstep++;
+        }
+
+        m_nloop++;
+    }
+    while (loop && m_run);
+
+    m_run = false;
+}
+
+static c_wave wave[N_GROUP];
+
+bool gpiox_set_sys(const gpiox_sys* calls)
+{
+    if (calls == nullptr)
+    {
+        sys = sys_os;
+        return true;
+    }
+
+    if ((calls->open == nullptr) || (calls->close == nullptr) || (calls->ioctl == nullptr) || (calls->read == nullptr))
+        return false;
+
+    sys = *calls;
+
+    return true;
+}
+
+const gpiox_sys& gpiox_get_sys()
+{
+    return sys;
+}
+
+const char* gpiox_get_chipname()
+{
+    return chips.get_chip(0)->get_name();
+}
+
+const char* gpiox_get_chiplabel()
+{
+    return chips.get_chip(0)->get_label();
+}
+
+bool gpiox_find(const char* name, uint32_t& pin)
+{
+    if (name == nullptr)
+        return false;
+
+    return chips.find(name, pin);
+}
+
+bool gpiox_mem_init(const char* name)
+{
+    for (uint32_t pin = 0; pin < N_PIN; pin++)
+        gpio_pin[pin].drop_mem();
+
+    return gpiomem.init(name);
+}
+
+void gpiox_mem_deinit()
+{
+    for (uint32_t pin = 0; pin < N_PIN; pin++)
+        gpio_pin[pin].drop_mem();
+
+    gpiomem.deinit();
+}
+
+bool gpiox_init(uint32_t pin, uint32_t mode, uint32_t setval)
+{
+    if (!CHECKLINE(pin) || gpio_pin[pin].is_claimed())
+        return false;
+
+    blink.stop(pin);
+    gpiox_unwatch(pin);
+    gpiox_unmirror(pin);
+
+    return gpio_pin[pin].init(pin, mode, setval);
+}
+
+bool gpiox_reconfigure(uint32_t pin, uint32_t mode, uint32_t setval)
+{
+    if (!CHECKLINE(pin) || gpio_pin[pin].is_claimed())
+        return false;
+
+    blink.stop(pin);
+    gpiox_unwatch(pin);
+    gpiox_unmirror(pin);
+
+    return gpio_pin[pin].reconfigure(pin, mode, setval);
+}
+
+bool gpiox_deinit(uint32_t pin)
+{
+    if (!CHECKLINE(pin) || gpio_pin[pin].is_claimed())
+        return false;
+
+    blink.stop(pin);
+    gpiox_unwatch(pin);
+    gpiox_unmirror(pin);
+
+    if (!gpio_pin[pin].deinit())
+        return false;
+
+    cache_clear(pin);
+
+    return true;
+}
+
+bool gpiox_claim(uint32_t pin, uint32_t gen)
+{
+    if (!CHECKLINE(pin))
+        return false;
+
+    return gpio_pin[pin].claim(gen);
+}
+
+void gpiox_unclaim(uint32_t pin)
+{
+    if (CHECKLINE(pin))
+        gpio_pin[pin].unclaim();
+}
+
+uint32_t gpiox_get_gen(uint32_t pin)
+{
+    if (!CHECKLINE(pin))
+        return 0;
+
+    return gpio_pin[pin].get_gen();
+}
+
+int32_t gpiox_get_fd(uint32_t pin)
+{
+    if (!CHECKLINE(pin))
+        return -1;
+
+    return gpio_pin[pin].get_fd();
+}
+
+bool gpiox_set_event_buffer(uint32_t size)
+{
+    if (size > N_EVENT_BUFFER_MAX)
+        return false;
+
+    event_buffer_size = size;
+
+    return true;
+}
+
+void gpiox_set_event_clock(bool realtime)
+{
+    event_clock_realtime = realtime;
+}
+
+bool gpiox_get_event_clock()
+{
+    return event_clock_realtime;
+}
+
+bool gpiox_set_edge(uint32_t pin, uint32_t edge, uint32_t debounce_us)
+{
+    if (!CHECKLINE(pin))
+        return false;
+
+    // watch seeds cache again if edges are still tracked
+    cache_clear(pin);
+
+    return gpio_pin[pin].set_edge(pin, edge, debounce_us);
+}
+
+int32_t gpiox_request(const uint32_t* pins, uint32_t* offsets, uint32_t num, uint32_t mode, uint32_t debounce_us, uint32_t edge)
+{
+    if ((pins == nullptr) || (num == 0) || (num > GPIO_V2_LINES_MAX) || is_output_mode(mode) || (edge > GPIO_EDGE_NONE))
+        return -1;
+
+    gpio_v2_line_request line_request;
+
+    memset(&line_request, 0, sizeof(line_request));
+
+    line_request.num_lines = num;
+    line_request.event_buffer_size = event_buffer_size;
+
+    c_chip* request_chip = nullptr;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        c_chip* chip;
+
+        if (!CHECKLINE(pins[i]) || !chips.get_line(pins[i], chip, line_request.offsets[i]))
+            return -1;
+
+        // all lines must be on same chip
+        if ((request_chip != nullptr) && (chip != request_chip))
+            return -1;
+
+        request_chip = chip;
+
+        if (!set_line_mode(line_request.config, i, mode, debounce_us))
+            return -1;
+
+        if (offsets != nullptr)
+            offsets[i] = line_request.offsets[i];
+    }
+
+    line_request.config.flags |= get_edge_flags(edge);
+
+    if ((edge != GPIO_EDGE_NONE) && event_clock_realtime)
+        line_request.config.flags |= GPIO_V2_LINE_FLAG_EVENT_CLOCK_REALTIME;
+
+    if (sys.ioctl(request_chip->get_fd(), GPIO_V2_GET_LINE_IOCTL, &line_request) == -1)
+        return -1;
+
+    return (line_request.fd < 0) ? -1 : line_request.fd;
+}
+
+void gpiox_release(int32_t fd)
+{
+    if (fd != -1)
+        sys.close(fd);
+}
+
+bool gpiox_read(uint32_t pin, uint32_t& val)
+{
+    if (!CHECKLINE(pin))
+        return false;
+
+    if (cache_read(pin, val))
+        return true;
+
+    return gpio_pin[pin].read(val);
+}
+
+bool gpiox_read_cached(uint32_t pin, uint32_t& val, uint64_t& timestamp_ns)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    // retries if state of pin changes while reading timestamp
+    for (;;)
+    {
+        uint64_t state = cache_state.load();
+        uint64_t ns = cache_ns[pin].load();
+
+        if (((state ^ cache_state.load()) & CACHE_BITS(pin)) != 0)
+            continue;
+
+        if ((((state >> 32) >> pin) & 1) == 0)
+            return false;
+
+        val = (state >> pin) & 1;
+        timestamp_ns = ns;
+
+        return true;
+    }
+}
+
+uint32_t gpiox_read_all(uint32_t& bits)
+{
+    uint64_t state = cache_state.load();
+
+    bits = (uint32_t) state;
+
+    return (uint32_t) (state >> 32);
+}
+
+void gpiox_cache_update(uint32_t pin, uint32_t val, uint64_t timestamp_ns)
+{
+    if (!CHECKPIN(pin))
+        return;
+
+    cache_ns[pin].store(timestamp_ns);
+
+    if (val > 0)
+        cache_state.fetch_or(1ULL << pin);
+    else
+        cache_state.fetch_and(~(1ULL << pin));
+}
+
+void gpiox_cache_seed(uint32_t pin, uint32_t val)
+{
+    if (!CHECKPIN(pin))
+        return;
+
+    cache_ns[pin].store(get_time_ns(event_clock_realtime ? CLOCK_REALTIME : CLOCK_MONOTONIC));
+
+    uint64_t state = cache_state.load();
+    uint64_t next;
+
+    do
+        next = (state & ~CACHE_BITS(pin)) | ((uint64_t) (val & 1) << pin) | ((1ULL << 32) << pin);
+    while (!cache_state.compare_exchange_weak(state, next));
+}
+
+void gpiox_cache_clear(uint32_t pin)
+{
+    cache_clear(pin);
+}
+
+bool gpiox_write(uint32_t pin, uint32_t val)
+{
+    if (!CHECKLINE(pin))
+        return false;
+
+    blink.stop(pin);
+
+    return gpio_pin[pin].write(val);
+}
+
+bool gpiox_read_mask(uint32_t mask, uint32_t& bits)
+{
+    if ((mask >> N_PIN) != 0)
+        return false;
+
+    // cached pins are answered from memory
+    uint64_t state = cache_state.load();
+    uint32_t cached = mask & (uint32_t) (state >> 32);
+
+    bits = (uint32_t) state & cached;
+    mask &= ~cached;
+
+    if (mask == 0)
+        return true;
+
+    uint32_t lev;
+
+    // one register read for all mapped pins, line requests are read per pin
+    const uint32_t* mem_lev = (gpiomem.is_active() && gpiomem.lev(lev)) ? &lev : nullptr;
+
+    // visits requested pins only
+    for (uint32_t rest = mask; rest != 0; rest &= rest - 1)
+    {
+        uint32_t pin = __builtin_ctz(rest);
+        uint32_t val;
+
+        if (!gpio_pin[pin].read(val, mem_lev))
+            return false;
+
+        if (val > 0)
+            bits |= 1U << pin;
+    }
+
+    return true;
+}
+
+bool gpiox_write_mask(uint32_t mask, uint32_t bits)
+{
+    if ((mask >> N_PIN) != 0)
+        return false;
+
+    uint32_t set_mask = 0;
+    uint32_t clr_mask = 0;
+    bool ret = true;
+
+    for (uint32_t pin = 0; pin < N_PIN; pin++)
+    {
+        if ((mask & (1U << pin)) == 0)
+            continue;
+
+        blink.stop(pin);
+
+        uint32_t bit = gpio_pin[pin].get_bit();
+
+        // mapped outputs are written together
+        if ((bit != 0) && gpio_pin[pin].is_output())
+        {
+            if (bits & (1U << pin))
+                set_mask |= bit;
+            else
+                clr_mask |= bit;
+        }
+        else if (!gpio_pin[pin].write((bits >> pin) & 1))
+            ret = false;
+    }
+
+    if (((set_mask | clr_mask) != 0) && !write_bits(set_mask, clr_mask))
+        ret = false;
+
+    return ret;
+}
+
+bool gpiox_group_init(uint32_t group, const uint32_t* pins, const uint32_t* modes, const uint32_t* setvals, uint32_t num)
+{
+    if (!CHECKGROUP(group) || (pins == nullptr) || (modes == nullptr) || (setvals == nullptr))
+        return false;
+
+    for (uint32_t i = 0; i < num; i++)
+        if (!CHECKLINE(pins[i]))
+            return false;
+
+    wave[group].stop();
+    blink.stop_group(group);
+
+    return gpio_group[group].init(pins, modes, setvals, num);
+}
+
+bool gpiox_group_deinit(uint32_t group)
+{
+    if (!CHECKGROUP(group))
+        return false;
+
+    wave[group].stop();
+    blink.stop_group(group);
+
+    gpio_group[group].deinit();
+
+    return true;
+}
+
+bool gpiox_group_read(uint32_t group, uint64_t& bits)
+{
+    if (!CHECKGROUP(group))
+        return false;
+
+    return gpio_group[group].read(bits);
+}
+
+bool gpiox_group_write(uint32_t group, uint64_t mask, uint64_t bits)
+{
+    if (!CHECKGROUP(group))
+        return false;
+
+    return gpio_group[group].write(mask, bits);
+}
+
+bool gpiox_blink(uint32_t pin, uint32_t period_ms)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    if (period_ms == 0)
+    {
+        blink.stop(pin);
+        return true;
+    }
+
+    if (!gpio_pin[pin].is_output())
+        return false;
+
+    return blink.start(pin, period_ms * NS_PER_MS, period_ms * NS_PER_MS / 2, false);
+}
+
+bool gpiox_pwm(uint32_t pin, uint32_t frequency, uint32_t dutycycle, bool realtime)
+{
+    if (!CHECKPIN(pin) || (frequency < PWM_FREQ_MIN) || (frequency > PWM_FREQ_MAX) || (dutycycle > PWM_DUTY_MAX))
+        return false;
+
+    if (!gpio_pin[pin].is_output())
+        return false;
+
+    // 0% and 100% are steady outputs
+    if ((dutycycle == 0) || (dutycycle == PWM_DUTY_MAX))
+    {
+        blink.stop(pin);
+        return gpio_pin[pin].write(dutycycle > 0);
+    }
+
+    uint64_t period = NS_PER_S / frequency;
+
+    return blink.start(pin, period, period * dutycycle / PWM_DUTY_MAX, realtime);
+}
+
+bool gpiox_blink_stop(uint32_t pin)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    blink.stop(pin);
+
+    return gpio_pin[pin].write(0);
+}
+
+bool gpiox_wave_start(uint32_t group, const gpiox_step* steps, uint32_t num, uint64_t mask, bool loop, bool realtime)
+{
+    if (!CHECKGROUP(group) || (gpio_group[group].get_fd() == -1))
+        return false;
+
+    blink.stop_group(group);
+
+    return wave[group].start(group, steps, num, mask, loop, realtime);
+}
+
+bool gpiox_group_pwm(uint32_t group, uint32_t frequency, const uint32_t* dutycycles, uint32_t num, bool realtime)
+{
+    if (!CHECKGROUP(group) || (dutycycles == nullptr) || (num == 0) || (num > GPIO_V2_LINES_MAX))
+        return false;
+
+    if ((frequency < PWM_FREQ_MIN) || (frequency > PWM_FREQ_MAX) || (gpio_group[group].get_fd() == -1))
+        return false;
+
+    uint64_t period = NS_PER_S / frequency;
+    uint64_t high[GPIO_V2_LINES_MAX];
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        if (dutycycles[i] > PWM_DUTY_MAX)
+            return false;
+
+        high[i] = period * dutycycles[i] / PWM_DUTY_MAX;
+    }
+
+    wave[group].stop();
+
+    return blink.start_group(group, period, high, num, realtime);
+}
+
+bool gpiox_group_pwm_stop(uint32_t group)
+{
+    if (!CHECKGROUP(group))
+        return false;
+
+    blink.stop_group(group);
+
+    // also steady channels of 0% and 100%
+    return gpio_group[group].write(blink.get_group_mask(group), 0);
+}
+
+bool gpiox_wave_stop(uint32_t group)
+{
+    if (!CHECKGROUP(group))
+        return false;
+
+    wave[group].stop();
+
+    return true;
+}
+
+bool gpiox_wave_status(uint32_t group, gpiox_wave_stat& wave_stat)
+{
+    if (!CHECKGROUP(group))
+        return false;
+
+    wave[group].get_stat(wave_stat);
+
+    return true;
 }
@@ -10,10 +10,37 @@
 #pragma once
 
 #include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @brief system calls for gpio chip and lines
+ */
+struct gpiox_sys
+{
+    int (*open)(const char* name, int flags);
+    int (*close)(int fd);
+    int (*ioctl)(int fd, unsigned long request, void* arg);
+    ssize_t (*read)(int fd, void* buf, size_t count);
+};
+
+/**
+ * @brief replaces system calls for gpio chip and lines (e.g. simulated chip)
+ * @param calls system calls, nullptr restores operating system calls
+ * @returns false on error, true on ok
+ * @note must be called before any other function, register memory is not affected
+ */
+bool gpiox_set_sys(const gpiox_sys* calls);
+
+/**
+ * @brief gets system calls for gpio chip and lines
+ * @returns system calls
+ */
+const gpiox_sys& gpiox_get_sys();
 
 /**
  * @brief returns Linux kernel name of this GPIO chip
  * @returns chip name
+ * @note chip is opened on first call of any function
  */
 const char* gpiox_get_chipname();
 
@@ -23,6 +50,34 @@ const char* gpiox_get_chipname();
  */
 const char* gpiox_get_chiplabel();
 
+/**
+ * @brief finds gpio pin by line name on all gpio chips
+ * @param name line name (e.g. "GPIO21")
+ * @param pin receives pin number
+ * @returns false if not found, true on ok
+ * @note all chips are opened and line names are indexed on first call
+ * @note lines of chip 0 offset 0..27 returns pin number 0..27,
+ * @note other lines gets extended pin number (28..63) for gpiox_init, gpiox_reconfigure, gpiox_deinit,
+ * @note gpiox_read, gpiox_write, gpiox_get_fd, gpiox_set_edge and gpiox_group_init
+ */
+bool gpiox_find(const char* name, uint32_t& pin);
+
+/**
+ * @brief maps gpio registers for fast read/write without ioctl
+ * @param name register file name, nullptr for /dev/gpiomem
+ * @returns false on error, true on ok
+ * @note pins initialized after call use registers for inputs without debounce and for GPIO_MODE_OUTPUT
+ * @note if gpio chip is not available pins are initialized by registers (BCM2711 pull-up/down)
+ * @note name can be a file of 0xF4 bytes or more for test and benchmark without hardware
+ */
+bool gpiox_mem_init(const char* name);
+
+/**
+ * @brief unmaps gpio registers, pins use ioctl
+ * @note pins initialized by registers only are de-initialized
+ */
+void gpiox_mem_deinit();
+
 /**
  * @brief initialized gpio pin with mode
  * @param pin pin number (0..27)
@@ -32,21 +87,132 @@ const char* gpiox_get_chiplabel();
  */
 bool gpiox_init(uint32_t pin, uint32_t mode, uint32_t setval);
 
+/**
+ * @brief changes mode of initialized gpio pin without release of pin
+ * @param pin pin number (0..27)
+ * @param mode gpio mode (see gpiox_def.h)
+ * @param setval debounce-time in us for inputs, state for outputs
+ * @returns false on error, true on ok
+ * @note not initialized pin is initialized as gpiox_init
+ */
+bool gpiox_reconfigure(uint32_t pin, uint32_t mode, uint32_t setval);
+
 /**
  * @brief de-initialized gpio pin
  * @param pin pin number (0..27)
  * @returns false on error, true on ok
+ * @note fails on pin claimed by gpiox_claim
  */
 bool gpiox_deinit(uint32_t pin);
 
+/**
+ * @brief claims initialized pin for single owner
+ * @param pin pin number (0..27)
+ * @param gen generation of pin at init (see gpiox_get_gen)
+ * @returns false if pin is not requested, re-initialized meanwhile or already claimed, true on ok
+ * @note while claimed gpiox_init, gpiox_reconfigure and gpiox_deinit of pin fails,
+ * @note so fd of gpiox_get_fd stays valid for owner
+ */
+bool gpiox_claim(uint32_t pin, uint32_t gen);
+
+/**
+ * @brief releases claim of pin
+ * @param pin pin number (0..27)
+ */
+void gpiox_unclaim(uint32_t pin);
+
+/**
+ * @brief gets line request file descriptor of gpio pin
+ * @param pin pin number (0..27)
+ * @returns file descriptor, -1 if pin is not initialized
+ */
+int32_t gpiox_get_fd(uint32_t pin);
+
+/**
+ * @brief gets generation of gpio pin
+ * @param pin pin number (0..27)
+ * @returns generation, changes on each init and de-init of pin
+ * @note cached fd of gpiox_get_fd is valid while generation is unchanged
+ */
+uint32_t gpiox_get_gen(uint32_t pin);
+
+/**
+ * @brief sets size of kernel edge event buffer for input pins
+ * @param size number of events (0..1024), 0 selects kernel default (16)
+ * @returns false on error, true on ok
+ * @note applies to input pins initialized after call, kernel drops events on buffer overflow
+ */
+bool gpiox_set_event_buffer(uint32_t size);
+
+/**
+ * @brief sets clock of edge event timestamps
+ * @param realtime true for CLOCK_REALTIME, false for CLOCK_MONOTONIC (default)
+ * @note applies to edge detection set after call, realtime follows clock adjustments (e.g. NTP, PTP)
+ */
+void gpiox_set_event_clock(bool realtime);
+
+/**
+ * @brief gets clock of edge event timestamps
+ * @returns true for CLOCK_REALTIME, false for CLOCK_MONOTONIC
+ */
+bool gpiox_get_event_clock();
+
+/**
+ * @brief sets edge detection on initialized input pin without release of pin
+ * @param pin pin number (0..27)
+ * @param edge gpio edge (see gpiox_def.h), GPIO_EDGE_NONE restores config of gpiox_init
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @returns false on error, true on ok
+ * @note edge events are read from gpiox_get_fd
+ */
+bool gpiox_set_edge(uint32_t pin, uint32_t edge, uint32_t debounce_us);
+
+/**
+ * @brief requests input lines with edge detection in one line request
+ * @param pins array of pin numbers, all lines on same chip, pins must not be initialized
+ * @param offsets array receives chip offsets of lines for edge events, can be nullptr
+ * @param num number of pins (1..64)
+ * @param mode input mode for all lines (see gpiox_def.h)
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param edge gpio edge (see gpiox_def.h)
+ * @returns line request file descriptor, -1 on error
+ * @note line index n of values is pins[n], caller owns file descriptor and releases with gpiox_release
+ * @note event buffer and event clock settings are applied
+ */
+int32_t gpiox_request(const uint32_t* pins, uint32_t* offsets, uint32_t num, uint32_t mode, uint32_t debounce_us, uint32_t edge);
+
+/**
+ * @brief releases line request of gpiox_request
+ * @param fd line request file descriptor
+ */
+void gpiox_release(int32_t fd);
+
 /**
  * @brief reads gpio pin state
  * @param pin pin number (0..27)
  * @param val receives state as 0/1
  * @returns false on error, true on ok
+ * @note state of pins watched on both edges is answered from cache without syscall
  */
 bool gpiox_read(uint32_t pin, uint32_t& val);
 
+/**
+ * @brief reads cached state of watched pin without syscall
+ * @param pin pin number (0..27)
+ * @param val receives state as 0/1
+ * @param timestamp_ns receives timestamp of last state change in event clock, time of first read after start of watch
+ * @returns false if state of pin is not cached, true on ok
+ * @note pins watched or mirrored on both edges and header pins of banks watched on both edges are cached
+ */
+bool gpiox_read_cached(uint32_t pin, uint32_t& val, uint64_t& timestamp_ns);
+
+/**
+ * @brief reads cached state of all watched pins without syscall
+ * @param bits receives state bitmap, bit n is pin n
+ * @returns bitmap of cached pins, bit n is pin n
+ */
+uint32_t gpiox_read_all(uint32_t& bits);
+
 /**
  * @brief writesto gpio pin
  * @param pin pin number (0..27)
@@ -54,3 +220,159 @@ bool gpiox_read(uint32_t pin, uint32_t& val);
  * @returns false on error, true on ok
  */
 bool gpiox_write(uint32_t pin, uint32_t val);
+
+/**
+ * @brief reads state of many gpio pins with one call
+ * @param mask bitmap of pins to read, bit n is pin n
+ * @param bits receives state bitmap, bit n is pin n
+ * @returns false on error, true on ok
+ * @note mapped pins are read with one register read, cached pins without read
+ */
+bool gpiox_read_mask(uint32_t mask, uint32_t& bits);
+
+/**
+ * @brief writes to many gpio pins with one call
+ * @param mask bitmap of pins to write, bit n is pin n
+ * @param bits state bitmap to set, bit n is pin n
+ * @returns false on error, true on ok
+ * @note mapped pins are written with one register write
+ */
+bool gpiox_write_mask(uint32_t mask, uint32_t bits);
+
+/**
+ * @brief initialized group of gpio pins with one line request
+ * @param group group number (0..7)
+ * @param pins array of pin numbers (0..27)
+ * @param modes array of gpio modes for each pin (see gpiox_def.h)
+ * @param setvals array of debounce-time in us for inputs, state for outputs
+ * @param num number of pins in arrays (1..64)
+ * @returns false on error, true on ok
+ * @note bit n of group bitmaps is pins[n]
+ */
+bool gpiox_group_init(uint32_t group, const uint32_t* pins, const uint32_t* modes, const uint32_t* setvals, uint32_t num);
+
+/**
+ * @brief de-initialized group of gpio pins
+ * @param group group number (0..7)
+ * @returns false on error, true on ok
+ */
+bool gpiox_group_deinit(uint32_t group);
+
+/**
+ * @brief reads state of all pins in group with one call
+ * @param group group number (0..7)
+ * @param bits receives state bitmap, bit n is pins[n]
+ * @returns false on error, true on ok
+ */
+bool gpiox_group_read(uint32_t group, uint64_t& bits);
+
+/**
+ * @brief writes to pins in group with one call
+ * @param group group number (0..7)
+ * @param mask bitmap of pins to write, bit n is pins[n]
+ * @param bits state bitmap to set, bit n is pins[n]
+ * @returns false on error, true on ok
+ */
+bool gpiox_group_write(uint32_t group, uint64_t mask, uint64_t bits);
+
+/**
+ * @brief blinks gpio output on period
+ * @param pin pin number (0..27)
+ * @param period_ms blink period in ms (1..), 0 stops blink
+ * @returns false on error, true on ok
+ * @note all blinking pins are served by one thread, pins with same period blinks in phase
+ * @note gpiox_init, gpiox_reconfigure, gpiox_deinit and gpiox_write stops blink
+ */
+bool gpiox_blink(uint32_t pin, uint32_t period_ms);
+
+/**
+ * @brief generates software pwm on gpio output
+ * @param pin pin number (0..27)
+ * @param frequency pwm frequency in Hz (PWM_FREQ_MIN..PWM_FREQ_MAX)
+ * @param dutycycle on time in % of period (0..PWM_DUTY_MAX), 0% and 100% sets steady output
+ * @param realtime true runs pwm thread with SCHED_FIFO
+ * @returns false on error, true on ok
+ * @note pwm shares thread of blink, next edges of all pins are kept in one time-ordered list
+ * @note pins with same frequency switches on in phase, gpiox_blink_stop stops pwm
+ * @note thread runs realtime while any pin is started with realtime
+ */
+bool gpiox_pwm(uint32_t pin, uint32_t frequency, uint32_t dutycycle, bool realtime);
+
+/**
+ * @brief stops blink or pwm and sets output to 0
+ * @param pin pin number (0..27)
+ * @returns false on error, true on ok
+ */
+bool gpiox_blink_stop(uint32_t pin);
+
+/**
+ * @brief step of wave, bitmap is written after delta time
+ */
+struct gpiox_step
+{
+    uint64_t delta_ns; // time in ns after previous step
+    uint64_t bits;     // state bitmap, bit n is pins[n] of group
+};
+
+/**
+ * @brief wave player statistics
+ */
+struct gpiox_wave_stat
+{
+    bool running;          // player is running
+    uint64_t steps;        // written steps
+    uint64_t loops;        // finished loops
+    uint64_t underruns;    // steps due before player was ready
+    uint64_t errors;       // failed writes of steps
+    uint64_t late_max_ns;  // max. time of write after step time
+    uint64_t late_mean_ns; // mean time of write after step time
+};
+
+/**
+ * @brief generates phase-aligned software pwm on group outputs
+ * @param group group number (0..7)
+ * @param frequency pwm frequency in Hz (PWM_FREQ_MIN..PWM_FREQ_MAX) of all channels
+ * @param dutycycles array of on time in % of period (0..PWM_DUTY_MAX), dutycycles[n] is pins[n]
+ * @param num number of channels (1..64), channels are pins[0..num-1] of group
+ * @param realtime true runs pwm thread with SCHED_FIFO
+ * @returns false on error, true on ok
+ * @note all channels switch on at start of period and channels with same dutycycle switch off together,
+ * @note each edge is written with one ioctl, at most num + 1 ioctls per period
+ * @note pwm shares thread of gpiox_pwm, group pwm and wave stops each other
+ */
+bool gpiox_group_pwm(uint32_t group, uint32_t frequency, const uint32_t* dutycycles, uint32_t num, bool realtime);
+
+/**
+ * @brief stops group pwm and sets outputs to 0
+ * @param group group number (0..7)
+ * @returns false on error, true on ok
+ */
+bool gpiox_group_pwm_stop(uint32_t group);
+
+/**
+ * @brief plays wave on group outputs from own thread
+ * @param group group number (0..7)
+ * @param steps array of steps, array is copied
+ * @param num number of steps
+ * @param mask bitmap of pins to write, bit n is pins[n]
+ * @param loop true: repeat steps until stop, false: play once
+ * @param realtime true: player thread runs with realtime priority
+ * @returns false on error, true on ok
+ * @note each step is written with one ioctl
+ */
+bool gpiox_wave_start(uint32_t group, const gpiox_step* steps, uint32_t num, uint64_t mask, bool loop, bool realtime);
+
+/**
+ * @brief stops wave player of group
+ * @param group group number (0..7)
+ * @returns false on error, true on ok
+ */
+bool gpiox_wave_stop(uint32_t group);
+
+/**
+ * @brief gets wave player statistics of group
+ * @param group group number (0..7)
+ * @param wave_stat receives statistics
+ * @returns false on error, true on ok
+ */
+bool gpiox_wave_status(uint32_t group, gpiox_wave_stat& wave_stat);
@@ -1,5 +1,5 @@
 /*
- * gpio modes for gpiox_init
+ * gpio modes for gpiox_init, edges for gpiox_watch
  *
  * (c) Derya Y. iiot2k@gmail.com
  *
@@ -20,3 +20,19 @@ enum {
     GPIO_MODE_OUTPUT_SOURCE,    // output source (Hi-Z on false, connected to +3.3V on true)
     GPIO_MODE_OUTPUT_SINK,      // output sink (Hi-Z on false, connected to ground on true)
 };
+
+// gpio edges
+enum {
+    GPIO_EDGE_RISING = 0,       // inactive to active
+    GPIO_EDGE_FALLING,          // active to inactive
+    GPIO_EDGE_BOTH,             // rising and falling
+    GPIO_EDGE_NONE,             // no edge detection
+};
+
+// number of gpio pins (0..27)
+#define N_PIN 28
+
+// software pwm limits for gpiox_pwm
+#define PWM_FREQ_MIN 1      // min. pwm frequency (Hz)
+#define PWM_FREQ_MAX 45000  // max. pwm frequency (Hz)
+#define PWM_DUTY_MAX 100    // max. duty cycle (%)
@@ -0,0 +1,63 @@
+/*
+ * gpiox internal functions between gpiox, watch and recording
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * gpiox_int.h
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include "gpiox_watch.h"
+
+#define NS_PER_MS ((uint64_t) 1000000)
+#define NS_PER_S ((uint64_t) 1000000000)
+
+/**
+ * @brief reads clock in ns
+ * @param clock clock id, CLOCK_REALTIME for event timestamps of realtime event clock
+ * @returns time in ns
+ */
+static inline uint64_t get_time_ns(clockid_t clock = CLOCK_MONOTONIC)
+{
+    timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return (uint64_t) ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+/**
+ * @brief starts cache of pin state with known state
+ * @param pin pin number (0..27)
+ * @param val state as 0/1
+ * @note called by watch and bank after both edges are set, timestamp is current time in event clock
+ */
+void gpiox_cache_seed(uint32_t pin, uint32_t val);
+
+/**
+ * @brief updates cached state of watched pin
+ * @param pin pin number (0..27)
+ * @param val state as 0/1
+ * @param timestamp_ns timestamp of edge event
+ * @note called for each read of edge events, pin must be seeded with gpiox_cache_seed
+ */
+void gpiox_cache_update(uint32_t pin, uint32_t val, uint64_t timestamp_ns);
+
+/**
+ * @brief stops cache of pin state
+ * @param pin pin number (0..27)
+ */
+void gpiox_cache_clear(uint32_t pin);
+
+/**
+ * @brief writes events to log if recording is started
+ * @param events array of events
+ * @param num number of events in array
+ * @note called from reactor thread, can be called from any thread
+ */
+void gpiox_record_write(const gpiox_event* events, uint32_t num);
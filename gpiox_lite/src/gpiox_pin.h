@@ -0,0 +1,122 @@
+/*
+ * gpiox compile-time pin handles
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * gpiox_pin.h
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "gpio.h"
+#include "gpiox.h"
+#include "gpiox_def.h"
+
+namespace gpiox {
+
+/**
+ * @brief gpio pin with pin number and mode checked at compile time
+ * @param N pin number (0..27)
+ * @param Mode gpio mode (see gpiox_def.h)
+ * @note pin is initialized and claimed on construction, unclaimed and de-initialized on destruction
+ * @note read/write uses cached line fd and prebuilt line values with one ioctl
+ * @note write on input pin is a compile error
+ * @note handle is single owner of line, gpiox_init/gpiox_reconfigure/gpiox_deinit of pin fails
+ *       while handle exists, so cached fd can't be closed while in use
+ */
+template <uint32_t N, uint32_t Mode>
+class pin
+{
+    static_assert(N < N_PIN, "pin number must be 0..27");
+    static_assert(Mode <= GPIO_MODE_OUTPUT_SINK, "invalid gpio mode");
+
+public:
+    static constexpr uint32_t number = N;
+    static constexpr uint32_t mode = Mode;
+    static constexpr bool is_output = (Mode == GPIO_MODE_OUTPUT) || (Mode == GPIO_MODE_OUTPUT_SOURCE) || (Mode == GPIO_MODE_OUTPUT_SINK);
+
+    /**
+     * @brief initializes pin
+     * @param setval debounce-time in us for inputs, state for outputs
+     */
+    explicit pin(uint32_t setval = 0)
+    {
+        m_fd = -1;
+
+        if (gpiox_init(N, Mode, setval))
+        {
+            uint32_t gen = gpiox_get_gen(N);
+            int32_t fd = gpiox_get_fd(N);
+
+            // pin re-initialized by other thread before claim is not owned
+            if ((fd != -1) && gpiox_claim(N, gen))
+                m_fd = fd;
+        }
+
+        m_ioctl = gpiox_get_sys().ioctl;
+
+        m_on.bits = 1;
+        m_on.mask = 1;
+        m_off.bits = 0;
+        m_off.mask = 1;
+    }
+
+    // line of failed init stays untouched
+    ~pin()
+    {
+        if (m_fd == -1)
+            return;
+
+        gpiox_unclaim(N);
+        gpiox_deinit(N);
+    }
+
+    pin(const pin&) = delete;
+    pin& operator=(const pin&) = delete;
+
+    /**
+     * @brief checks if pin is initialized
+     * @returns true if pin is initialized and claimed by handle
+     */
+    inline bool is_init() const { return m_fd != -1; }
+
+    /**
+     * @brief reads pin state
+     * @param val receives state as 0/1
+     * @returns false on error, true on ok
+     */
+    inline bool read(uint32_t& val) const
+    {
+        gpio_v2_line_values line_values = m_off;
+
+        if (m_ioctl(m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) == -1)
+            return false;
+
+        val = (uint32_t) line_values.bits;
+
+        return true;
+    }
+
+    /**
+     * @brief writes to output pin
+     * @param val state as 0/1 to set
+     * @returns false on error, true on ok
+     */
+    inline bool write(uint32_t val)
+    {
+        static_assert(is_output, "write on input pin");
+
+        return m_ioctl(m_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, (val > 0) ? &m_on : &m_off) != -1;
+    }
+
+private:
+    int32_t m_fd;
+    int (*m_ioctl)(int fd, unsigned long request, void* arg);
+    gpio_v2_line_values m_on;  // prebuilt values for state 1
+    gpio_v2_line_values m_off; // prebuilt values for state 0, read mask
+};
+
+} // namespace
@@ -0,0 +1,306 @@
+/*
+ * gpiox edge event recording
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * gpiox_record.cpp
+ *
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gpiox_record.h"
+#include "gpiox_int.h"
+
+#define RECORD_MAGIC "GPIOXREC"
+#define RECORD_VERSION 1
+#define N_SEGMENT_MAX 1000
+#define N_SEGMENT_EVENTS_MAX (1U << 24)
+
+// record is event as is
+static_assert(sizeof(gpiox_event) == 32, "record size must be 32 bytes");
+
+// header of segment file, followed by records
+struct s_segment
+{
+    char magic[8];        // RECORD_MAGIC
+    uint32_t version;     // RECORD_VERSION
+    uint32_t record_size; // size of gpiox_event
+    uint64_t sequence;    // number of segment since start of recording
+    uint64_t capacity;    // max. records in segment
+    uint64_t count;       // records written, updated after each write
+    uint8_t reserved[24];
+};
+
+static_assert(sizeof(s_segment) == 64, "segment header must be 64 bytes");
+
+static std::string get_segment_name(const std::string& path, uint32_t index)
+{
+    char ext[16];
+
+    snprintf(ext, sizeof(ext), ".%03u", index);
+
+    return path + ext;
+}
+
+// append-only log in rotating segments
+class c_record
+{
+public:
+    c_record()
+    {
+        m_active = false;
+        m_segments = 0;
+        m_capacity = 0;
+        m_sequence = 0;
+        m_fd = -1;
+        m_map = nullptr;
+        m_size = 0;
+    }
+
+    ~c_record()
+    {
+        stop();
+    }
+
+    bool start(const char* path, uint32_t segment_events, uint32_t segments);
+    void stop();
+    void write(const gpiox_event* events, uint32_t num);
+
+private:
+    bool open_segment();
+    void close_segment();
+
+    std::atomic<bool> m_active;
+    std::mutex m_mtx; // segment and writes
+    std::string m_path;
+    uint32_t m_segments;
+    uint64_t m_capacity; // records per segment
+    uint64_t m_sequence; // sequence of open segment
+    int m_fd;
+    s_segment* m_map; // mapped segment, nullptr if closed
+    size_t m_size;
+};
+
+bool c_record::start(const char* path, uint32_t segment_events, uint32_t segments)
+{
+    if ((path == nullptr) || (segment_events == 0) || (segment_events > N_SEGMENT_EVENTS_MAX) ||
+        (segments == 0) || (segments > N_SEGMENT_MAX))
+        return false;
+
+    stop();
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_path = path;
+    m_segments = segments;
+    m_capacity = segment_events;
+    m_sequence = 0;
+
+    // segments of previous recording would be read as part of new log
+    for (uint32_t i = 0; i < N_SEGMENT_MAX; i++)
+    {
+        if ((unlink(get_segment_name(m_path, i).c_str()) == -1) && (errno == ENOENT))
+            break;
+    }
+
+    if (!open_segment())
+        return false;
+
+    m_active = true;
+
+    return true;
+}
+
+void c_record::stop()
+{
+    m_active = false;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    close_segment();
+}
+
+// opens next segment file, overwrites oldest segment, m_mtx must be held
+bool c_record::open_segment()
+{
+    close_segment();
+
+    std::string name = get_segment_name(m_path, m_sequence % m_segments);
+
+    m_size = sizeof(s_segment) + m_capacity * sizeof(gpiox_event);
+    m_fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (m_fd == -1)
+        return false;
+
+    if (ftruncate(m_fd, m_size) == -1)
+    {
+        close_segment();
+        return false;
+    }
+
+    void* map = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+        close_segment();
+        return false;
+    }
+
+    m_map = static_cast<s_segment*>(map);
+
+    memcpy(m_map->magic, RECORD_MAGIC, sizeof(m_map->magic));
+    m_map->version = RECORD_VERSION;
+    m_map->record_size = sizeof(gpiox_event);
+    m_map->sequence = m_sequence++;
+    m_map->capacity = m_capacity;
+    m_map->count = 0;
+
+    return true;
+}
+
+// unmaps segment, m_mtx must be held
+void c_record::close_segment()
+{
+    if (m_map != nullptr)
+        munmap(m_map, m_size);
+
+    if (m_fd != -1)
+        close(m_fd);
+
+    m_map = nullptr;
+    m_fd = -1;
+}
+
+void c_record::write(const gpiox_event* events, uint32_t num)
+{
+    if (!m_active.load(std::memory_order_relaxed))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (m_map == nullptr)
+        return;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        uint64_t count = m_map->count;
+
+        // rotates to next segment
+        if (count == m_capacity)
+        {
+            if (!open_segment())
+            {
+                m_active = false;
+                return;
+            }
+
+            count = 0;
+        }
+
+        gpiox_event* records = reinterpret_cast<gpiox_event*>(m_map + 1);
+
+        records[count] = events[i];
+
+        // count after record, reader of crashed log sees complete records
+        __atomic_store_n(&m_map->count, count + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static c_record record;
+
+bool gpiox_record_start(const char* path, uint32_t segment_events, uint32_t segments)
+{
+    return record.start(path, segment_events, segments);
+}
+
+void gpiox_record_stop()
+{
+    record.stop();
+}
+
+void gpiox_record_write(const gpiox_event* events, uint32_t num)
+{
+    record.write(events, num);
+}
+
+bool gpiox_record_read(const char* path, gpiox_record_cb cb, void* arg)
+{
+    if ((path == nullptr) || (cb == nullptr))
+        return false;
+
+    // sequence and file name of valid segments
+    std::vector<std::pair<uint64_t, std::string>> segments;
+
+    for (uint32_t i = 0; i < N_SEGMENT_MAX; i++)
+    {
+        std::string name = get_segment_name(path, i);
+        int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd == -1)
+            break;
+
+        s_segment header;
+
+        if ((read(fd, &header, sizeof(header)) == sizeof(header)) &&
+            (memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) == 0) &&
+            (header.version == RECORD_VERSION) && (header.record_size == sizeof(gpiox_event)))
+            segments.emplace_back(header.sequence, name);
+
+        close(fd);
+    }
+
+    if (segments.empty())
+        return false;
+
+    std::sort(segments.begin(), segments.end());
+
+    for (const auto& segment : segments)
+    {
+        int fd = open(segment.second.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd == -1)
+            return false;
+
+        struct stat st;
+
+        if ((fstat(fd, &st) == -1) || ((size_t) st.st_size < sizeof(s_segment)))
+        {
+            close(fd);
+            return false;
+        }
+
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        close(fd);
+
+        if (map == MAP_FAILED)
+            return false;
+
+        const s_segment* header = static_cast<const s_segment*>(map);
+        uint64_t count = std::min(header->count, (uint64_t) ((st.st_size - sizeof(s_segment)) / sizeof(gpiox_event)));
+
+        bool next = (count == 0) || cb(reinterpret_cast<const gpiox_event*>(header + 1), count, arg);
+
+        munmap(map, st.st_size);
+
+        if (!next)
+            break;
+    }
+
+    return true;
+}
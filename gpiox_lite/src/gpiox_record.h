@@ -0,0 +1,50 @@
+/*
+ * gpiox edge event recording
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * gpiox_record.h
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "gpiox_watch.h"
+
+/**
+ * @brief starts recording of all kernel edge events of watched pins
+ * @param path file name of log, segments are path.000, path.001, ...
+ * @param segment_events number of events in one segment file (1..16777216)
+ * @param segments number of segment files (1..1000), oldest segment is overwritten
+ * @returns false on error, true on ok
+ * @note segments are memory mapped, each event is one record of 32 bytes written without system call
+ * @note events are recorded before edge filter of watch and before replay (see gpiox_replay)
+ * @note events of watches, banks and encoders are recorded
+ * @note start removes all segments of previous recording with same path
+ */
+bool gpiox_record_start(const char* path, uint32_t segment_events, uint32_t segments);
+
+/**
+ * @brief stops recording and unmaps segment
+ */
+void gpiox_record_stop();
+
+/**
+ * @brief read callback function
+ * @param events array of events of one segment in recorded order
+ * @param num number of events in array
+ * @param arg argument of gpiox_record_read
+ * @returns false stops reading, true continues
+ */
+typedef bool (*gpiox_record_cb)(const gpiox_event* events, uint32_t num, void* arg);
+
+/**
+ * @brief reads recorded log, segments in order of recording
+ * @param path file name of log given to gpiox_record_start
+ * @param cb callback function called for each segment
+ * @param arg argument for callback function
+ * @returns false on error or if no segment found, true on ok
+ */
+bool gpiox_record_read(const char* path, gpiox_record_cb cb, void* arg);
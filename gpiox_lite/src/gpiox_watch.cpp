@@ -0,0 +1,2196 @@
+/*
+ * gpiox watch functions
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * gpiox_watch.cpp
+ *
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gpio.h"
+#include "gpiox.h"
+#include "gpiox_def.h"
+#include "gpiox_watch.h"
+#include "gpiox_record.h"
+#include "gpiox_int.h"
+
+#define N_EVENT 64 // max. events read at once
+#define N_READY 16 // max. ready line fds per wakeup
+#define N_THREAD_MAX 4 // max. reactor threads
+#define N_WORKER_MAX 8 // max. dispatch threads
+#define N_DISPATCH_MAX 4096 // max. events queued for dispatch per pin
+#define N_QUEUE_MAX 65536 // max. events in queue
+#define N_BUCKET 16 // buckets of counter window
+#define WINDOW_MAX_MS 60000 // max. counter window
+
+#define BUCKET_BITS 24 // count bits of bucket, upper bits are epoch
+#define BUCKET_COUNT ((1ULL << BUCKET_BITS) - 1)
+#define BUCKET_EPOCH ((1ULL << (64 - BUCKET_BITS)) - 1)
+
+#define REACTOR_STOP (~0ULL) // epoll data of stop event
+
+#define N_ENCODER 4 // max. encoders
+#define N_SLOT (N_PIN + N_ENCODER + N_PIN + N_BANK) // reactor slots, pins followed by encoders, coalesce timers and banks
+#define SLOT_ENCODER(e) (N_PIN + e)
+#define SLOT_TIMER(p) (N_PIN + N_ENCODER + p)
+#define SLOT_BANK(b) (N_PIN + N_ENCODER + N_PIN + b)
+
+#define CHECKPIN(p) (p < N_PIN)
+#define CHECKENCODER(e) (e < N_ENCODER)
+#define CHECKBANK(b) (b < N_BANK)
+#define CHECKLINE(p) (p < 64)
+
+static_assert(N_SLOT <= 64, "reactor slots must fit into mask");
+
+// handler of readable line fd, called from reactor thread
+typedef void (*reactor_fn)(void* obj, int32_t fd);
+
+// reactor with one epoll set for all watched line fds
+// slots are dispatched by one thread or by a pool, one slot is never dispatched by two threads
+class c_reactor
+{
+public:
+    c_reactor()
+    {
+        m_epfd = -1;
+        m_efd = -1;
+        m_num = 1;
+        m_slots = 0;
+
+        for (uint32_t i = 0; i < N_SLOT; i++)
+        {
+            m_slot[i].fd = -1;
+            m_slot[i].gen = 0;
+            m_slot[i].fn = nullptr;
+            m_slot[i].obj = nullptr;
+        }
+    }
+
+    ~c_reactor()
+    {
+        stop();
+    }
+
+    bool set_threads(uint32_t num);
+    bool add(uint32_t index, int32_t fd, reactor_fn fn, void* obj);
+    void remove(uint32_t index);
+    std::mutex& get_lock(uint32_t index) { return m_slot[index].mtx; }
+
+private:
+    bool start();
+    void stop();
+    void loop();
+    void dispatch(uint64_t data, uint32_t events);
+    uint32_t get_flags() { return EPOLLIN | ((m_num > 1) ? (uint32_t) EPOLLONESHOT : 0); }
+
+    // dispatch slot of line fd
+    struct s_slot
+    {
+        std::mutex mtx; // held while slot is dispatched
+        std::atomic<uint32_t> gen; // incremented on add and remove, stale events are dropped
+        int32_t fd;
+        reactor_fn fn;
+        void* obj;
+    };
+
+    int32_t m_epfd;
+    int32_t m_efd; // stop event
+    uint32_t m_num; // number of threads
+    uint64_t m_slots; // mask of registered slots
+    std::mutex m_mtx; // registration, start and stop
+    std::vector<std::thread> m_threads;
+    s_slot m_slot[N_SLOT];
+};
+
+// watch of pin with callback and/or state mirror
+// kernel watches both edges if pin is mirrored, callback receives events of watched edge
+class c_watch
+{
+public:
+    c_watch()
+    {
+        m_active = false;
+        m_pin = 0;
+        m_edge = GPIO_EDGE_NONE;
+        m_debounce_us = 0;
+        m_cb = nullptr;
+        m_arg = nullptr;
+        m_state = nullptr;
+        m_mirror_cb = nullptr;
+        m_mirror_arg = nullptr;
+        m_line_seqno = 0;
+        m_lost = 0;
+        m_cache = false;
+    }
+
+    ~c_watch()
+    {
+        stop();
+    }
+
+    bool set_watch(uint32_t pin, uint32_t edge, uint32_t debounce_us, gpiox_watch_cb cb, void* arg);
+    bool set_mirror(uint32_t pin, uint32_t debounce_us, int32_t* state, gpiox_mirror_cb cb, void* arg);
+    void clear_watch(uint32_t pin);
+    void clear_mirror(uint32_t pin);
+
+    void inject(const gpiox_event& event);
+
+    static void on_ready(void* obj, int32_t fd);
+
+private:
+    void handle(int32_t fd);
+    void process(const gpiox_event* events, uint32_t num);
+    bool restart(uint32_t pin);
+    void stop();
+
+    std::atomic<bool> m_active; // registered in reactor, read by inject of replay thread
+    uint32_t m_pin;
+    uint32_t m_edge; // watched edge, GPIO_EDGE_NONE if not watched
+    uint32_t m_debounce_us;
+    gpiox_watch_cb m_cb;
+    void* m_arg;
+    int32_t* m_state; // mirror, nullptr if not mirrored
+    gpiox_mirror_cb m_mirror_cb;
+    void* m_mirror_arg;
+    uint32_t m_line_seqno; // sequence number of last event, 0 after start
+    uint32_t m_lost; // dropped events not reported yet
+    bool m_cache; // both edges are read, state of pin is cached
+};
+
+// reactor is destroyed after watches
+static c_reactor reactor;
+
+bool c_watch::set_watch(uint32_t pin, uint32_t edge, uint32_t debounce_us, gpiox_watch_cb cb, void* arg)
+{
+    if ((cb == nullptr) || (edge >= GPIO_EDGE_NONE))
+        return false;
+
+    stop();
+
+    m_edge = edge;
+    m_debounce_us = debounce_us;
+    m_cb = cb;
+    m_arg = arg;
+
+    if (restart(pin))
+        return true;
+
+    clear_watch(pin);
+
+    return false;
+}
+
+bool c_watch::set_mirror(uint32_t pin, uint32_t debounce_us, int32_t* state, gpiox_mirror_cb cb, void* arg)
+{
+    if (state == nullptr)
+        return false;
+
+    stop();
+
+    m_state = state;
+    m_mirror_cb = cb;
+    m_mirror_arg = arg;
+
+    // watch sets debounce
+    if (m_edge == GPIO_EDGE_NONE)
+        m_debounce_us = debounce_us;
+
+    if (!restart(pin))
+    {
+        clear_mirror(pin);
+        return false;
+    }
+
+    // seeds mirror after start under slot lock, events handled later are newer than read
+    std::lock_guard<std::mutex> lock(reactor.get_lock(pin));
+    uint32_t val;
+
+    if (gpiox_read(pin, val))
+    {
+        __atomic_store_n(&state[pin], val, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&state[N_PIN], 1, __ATOMIC_SEQ_CST);
+    }
+
+    return true;
+}
+
+void c_watch::clear_watch(uint32_t pin)
+{
+    stop();
+
+    m_edge = GPIO_EDGE_NONE;
+    m_cb = nullptr;
+    m_arg = nullptr;
+
+    restart(pin);
+}
+
+void c_watch::clear_mirror(uint32_t pin)
+{
+    stop();
+
+    m_state = nullptr;
+    m_mirror_cb = nullptr;
+    m_mirror_arg = nullptr;
+
+    restart(pin);
+}
+
+// sets kernel edges and registers pin in reactor, watch must be stopped
+bool c_watch::restart(uint32_t pin)
+{
+    if ((m_edge == GPIO_EDGE_NONE) && (m_state == nullptr))
+    {
+        gpiox_set_edge(pin, GPIO_EDGE_NONE, 0);
+        return true;
+    }
+
+    int32_t fd = gpiox_get_fd(pin);
+
+    if (fd == -1)
+        return false;
+
+    // mirror needs both edges
+    uint32_t edge = (m_state != nullptr) ? (uint32_t) GPIO_EDGE_BOTH : m_edge;
+
+    if (!gpiox_set_edge(pin, edge, m_debounce_us))
+        return false;
+
+    m_pin = pin;
+    m_line_seqno = 0;
+    m_lost = 0;
+    m_cache = (edge == GPIO_EDGE_BOTH);
+
+    if (!reactor.add(pin, fd, on_ready, this))
+        return false;
+
+    m_active = true;
+
+    // seeds cache with one read, events pending before read are older and leaves same state
+    if (m_cache)
+    {
+        std::lock_guard<std::mutex> lock(reactor.get_lock(pin));
+        uint32_t val;
+
+        // set_edge has stopped cache, value is read from line
+        if (gpiox_read(pin, val))
+            gpiox_cache_seed(pin, val);
+    }
+
+    return true;
+}
+
+// unregisters pin, no callback is called after return
+void c_watch::stop()
+{
+    // cleared first, inject of replay stops before slot is removed
+    if (m_active.exchange(false))
+        reactor.remove(m_pin);
+}
+
+void c_watch::on_ready(void* obj, int32_t fd)
+{
+    static_cast<c_watch*>(obj)->handle(fd);
+}
+
+// handles readable line fd, called from reactor thread
+void c_watch::handle(int32_t fd)
+{
+    gpio_v2_line_event line_events[N_EVENT];
+    gpiox_event events[N_EVENT];
+
+    // drains kernel buffer with one read, rest is read on next wakeup
+    ssize_t len = gpiox_get_sys().read(fd, line_events, sizeof(line_events));
+
+    if (len < (ssize_t) sizeof(gpio_v2_line_event))
+        return;
+
+    uint32_t num = len / sizeof(gpio_v2_line_event);
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        events[i].timestamp_ns = line_events[i].timestamp_ns;
+        events[i].pin = m_pin;
+        events[i].edge = (line_events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+        events[i].seqno = line_events[i].seqno;
+        events[i].line_seqno = line_events[i].line_seqno;
+        events[i].lost = 0;
+        events[i].count = 1;
+
+        // gap in sequence is overflow of kernel buffer
+        if ((m_line_seqno != 0) && (line_events[i].line_seqno > m_line_seqno + 1))
+            events[i].lost = line_events[i].line_seqno - m_line_seqno - 1;
+
+        m_line_seqno = line_events[i].line_seqno;
+    }
+
+    gpiox_record_write(events, num);
+
+    // replayed events don't change cache
+    if (m_cache)
+        gpiox_cache_update(m_pin, (events[num - 1].edge == GPIO_EDGE_RISING) ? 1 : 0, events[num - 1].timestamp_ns);
+
+    process(events, num);
+}
+
+// passes kernel or replayed events to mirror and callback, called with slot lock
+void c_watch::process(const gpiox_event* events, uint32_t num)
+{
+    gpiox_event watched[N_EVENT];
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        m_lost += events[i].lost;
+
+        // callback receives only watched edges
+        if ((m_edge != GPIO_EDGE_BOTH) && (m_edge != events[i].edge))
+            continue;
+
+        watched[n] = events[i];
+        watched[n].lost = m_lost;
+        m_lost = 0;
+        n++;
+    }
+
+    // last event is state of pin
+    if (m_state != nullptr)
+    {
+        uint32_t state = (events[num - 1].edge == GPIO_EDGE_RISING) ? 1 : 0;
+
+        __atomic_store_n(&m_state[m_pin], state, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&m_state[N_PIN], 1, __ATOMIC_SEQ_CST);
+
+        if (m_mirror_cb != nullptr)
+            m_mirror_cb(m_pin, m_mirror_arg);
+    }
+
+    if ((n > 0) && (m_cb != nullptr))
+        m_cb(watched, n, m_arg);
+}
+
+// passes replayed event as kernel event, serialized with reactor thread of pin
+void c_watch::inject(const gpiox_event& event)
+{
+    std::lock_guard<std::mutex> lock(reactor.get_lock(m_pin));
+
+    if (m_active)
+        process(&event, 1);
+}
+
+// single producer single consumer queue of events
+// reactor thread pushes, one user thread pops
+class c_queue
+{
+public:
+    c_queue()
+    {
+        m_size = 0;
+        m_head = 0;
+        m_tail = 0;
+        m_lost = 0;
+    }
+
+    bool init(uint32_t size);
+    uint32_t pop(gpiox_event* events, uint32_t num);
+
+    static void push(const gpiox_event* events, uint32_t num, void* arg);
+
+private:
+    std::unique_ptr<gpiox_event[]> m_events;
+    uint32_t m_size; // power of 2
+    std::atomic<uint32_t> m_head; // next write, written by reactor thread
+    std::atomic<uint32_t> m_tail; // next read, written by user thread
+    uint32_t m_lost; // events dropped on full queue, reactor thread
+};
+
+// allocates queue, pin must not be watched
+bool c_queue::init(uint32_t size)
+{
+    if ((size == 0) || (size > N_QUEUE_MAX))
+        return false;
+
+    uint32_t n = 1;
+
+    while (n < size)
+        n <<= 1;
+
+    if (n != m_size)
+    {
+        m_events.reset(new gpiox_event[n]);
+        m_size = n;
+    }
+
+    m_head = 0;
+    m_tail = 0;
+    m_lost = 0;
+
+    return true;
+}
+
+// watch callback, runs on reactor thread
+void c_queue::push(const gpiox_event* events, uint32_t num, void* arg)
+{
+    c_queue* queue = static_cast<c_queue*>(arg);
+
+    uint32_t head = queue->m_head.load(std::memory_order_relaxed);
+    uint32_t tail = queue->m_tail.load(std::memory_order_acquire);
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        queue->m_lost += events[i].lost;
+
+        if ((head - tail) == queue->m_size)
+        {
+            queue->m_lost++;
+            continue;
+        }
+
+        gpiox_event& event = queue->m_events[head & (queue->m_size - 1)];
+
+        event = events[i];
+        event.lost = queue->m_lost;
+        queue->m_lost = 0;
+        head++;
+    }
+
+    queue->m_head.store(head, std::memory_order_release);
+}
+
+uint32_t c_queue::pop(gpiox_event* events, uint32_t num)
+{
+    if (m_size == 0)
+        return 0;
+
+    uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    uint32_t head = m_head.load(std::memory_order_acquire);
+    uint32_t n = 0;
+
+    while ((tail != head) && (n < num))
+        events[n++] = m_events[tail++ & (m_size - 1)];
+
+    m_tail.store(tail, std::memory_order_release);
+
+    return n;
+}
+
+static c_queue queue[N_PIN];
+
+// edge counter with rate over sliding window of buckets
+// reactor thread counts, any thread reads
+class c_counter
+{
+public:
+    c_counter()
+    {
+        m_bucket_ns = 0;
+        m_clock = CLOCK_MONOTONIC;
+        m_start_ns = 0;
+        m_last_ns = 0;
+        m_count = 0;
+        m_period_ns = 0;
+        m_lost = 0;
+
+        for (uint32_t i = 0; i < N_BUCKET; i++)
+            m_bucket[i] = 0;
+    }
+
+    bool init(uint32_t window_ms);
+    bool read(gpiox_count_stat& stat);
+
+    static void push(const gpiox_event* events, uint32_t num, void* arg);
+
+private:
+
+    std::atomic<uint64_t> m_bucket[N_BUCKET]; // epoch and count of bucket
+    uint64_t m_bucket_ns; // 0 if not started
+    clockid_t m_clock; // clock of kernel timestamps
+    uint64_t m_start_ns;
+    uint64_t m_last_ns; // timestamp of last edge, reactor thread
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_period_ns;
+    std::atomic<uint32_t> m_lost;
+};
+
+// resets counter, pin must not be watched
+bool c_counter::init(uint32_t window_ms)
+{
+    if ((window_ms == 0) || (window_ms > WINDOW_MAX_MS))
+        return false;
+
+    for (uint32_t i = 0; i < N_BUCKET; i++)
+        m_bucket[i] = 0;
+
+    m_bucket_ns = window_ms * NS_PER_MS / N_BUCKET;
+    m_clock = gpiox_get_event_clock() ? CLOCK_REALTIME : CLOCK_MONOTONIC;
+    m_start_ns = get_time_ns(m_clock);
+    m_last_ns = 0;
+    m_count = 0;
+    m_period_ns = 0;
+    m_lost = 0;
+
+    return true;
+}
+
+// watch callback, runs on reactor thread
+void c_counter::push(const gpiox_event* events, uint32_t num, void* arg)
+{
+    c_counter* counter = static_cast<c_counter*>(arg);
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        uint64_t ts = events[i].timestamp_ns;
+
+        if (events[i].lost != 0)
+            counter->m_lost.fetch_add(events[i].lost, std::memory_order_relaxed);
+
+        if ((counter->m_last_ns != 0) && (ts > counter->m_last_ns))
+            counter->m_period_ns.store(ts - counter->m_last_ns, std::memory_order_relaxed);
+
+        counter->m_last_ns = ts;
+
+        // bucket of other epoch is reused
+        uint64_t epoch = (ts / counter->m_bucket_ns) & BUCKET_EPOCH;
+        std::atomic<uint64_t>& bucket = counter->m_bucket[epoch % N_BUCKET];
+        uint64_t val = bucket.load(std::memory_order_relaxed);
+
+        if ((val >> BUCKET_BITS) != epoch)
+            val = epoch << BUCKET_BITS;
+
+        if ((val & BUCKET_COUNT) != BUCKET_COUNT)
+            val++;
+
+        bucket.store(val, std::memory_order_relaxed);
+    }
+
+    counter->m_count.fetch_add(num, std::memory_order_release);
+}
+
+bool c_counter::read(gpiox_count_stat& stat)
+{
+    if (m_bucket_ns == 0)
+        return false;
+
+    stat.count = m_count.load(std::memory_order_acquire);
+    stat.period_ns = m_period_ns.load(std::memory_order_relaxed);
+    stat.lost = m_lost.load(std::memory_order_relaxed);
+
+    uint64_t now = get_time_ns(m_clock);
+    uint64_t now_epoch = (now / m_bucket_ns) & BUCKET_EPOCH;
+    uint64_t sum = 0;
+
+    // buckets of window up to current bucket
+    for (uint32_t i = 0; i < N_BUCKET; i++)
+    {
+        uint64_t val = m_bucket[i].load(std::memory_order_relaxed);
+
+        if (((now_epoch - (val >> BUCKET_BITS)) & BUCKET_EPOCH) < N_BUCKET)
+            sum += val & BUCKET_COUNT;
+    }
+
+    // window covers current bucket partly, shorter after start
+    uint64_t window_ns = (N_BUCKET - 1) * m_bucket_ns + (now % m_bucket_ns);
+
+    if (now - m_start_ns < window_ns)
+        window_ns = now - m_start_ns;
+
+    stat.rate = (window_ns > 0) ? (double) sum * NS_PER_S / (double) window_ns : 0.0;
+
+    return true;
+}
+
+static c_counter counter[N_PIN];
+
+// pulse capture with statistic of high, low and period time
+// reactor thread writes, any thread reads consistent statistic by sequence lock
+class c_capture
+{
+public:
+    c_capture()
+    {
+        reset();
+    }
+
+    void reset();
+    bool read(gpiox_capture_stat& stat);
+
+    static void push(const gpiox_event* events, uint32_t num, void* arg);
+
+private:
+    // running statistic of time
+    struct s_time
+    {
+        uint64_t last_ns;
+        uint64_t min_ns;
+        uint64_t max_ns;
+        uint64_t sum_ns;
+        uint64_t num;
+    };
+
+    static void add(s_time& time, uint64_t ns);
+    static void get(const s_time& time, gpiox_time_stat& stat);
+
+    // reactor thread
+    uint64_t m_rise_ns; // 0 if unknown
+    uint64_t m_fall_ns; // 0 if unknown
+
+    // written under sequence lock
+    std::atomic<uint32_t> m_seq; // odd while written
+    s_time m_high;
+    s_time m_low;
+    s_time m_period;
+    uint32_t m_lost;
+};
+
+// resets statistic, pin must not be watched
+void c_capture::reset()
+{
+    m_rise_ns = 0;
+    m_fall_ns = 0;
+    m_seq = 0;
+    m_high = s_time{ 0, 0, 0, 0, 0 };
+    m_low = m_high;
+    m_period = m_high;
+    m_lost = 0;
+}
+
+void c_capture::add(s_time& time, uint64_t ns)
+{
+    if ((time.num == 0) || (ns < time.min_ns))
+        time.min_ns = ns;
+
+    if (ns > time.max_ns)
+        time.max_ns = ns;
+
+    time.last_ns = ns;
+    time.sum_ns += ns;
+    time.num++;
+}
+
+void c_capture::get(const s_time& time, gpiox_time_stat& stat)
+{
+    stat.last_ns = time.last_ns;
+    stat.min_ns = time.min_ns;
+    stat.max_ns = time.max_ns;
+    stat.mean_ns = (time.num > 0) ? time.sum_ns / time.num : 0;
+}
+
+// watch callback, runs on reactor thread
+void c_capture::push(const gpiox_event* events, uint32_t num, void* arg)
+{
+    c_capture* capture = static_cast<c_capture*>(arg);
+
+    capture->m_seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        const gpiox_event& event = events[i];
+        uint64_t ts = event.timestamp_ns;
+
+        // edges before gap can not be paired
+        if (event.lost != 0)
+        {
+            capture->m_lost += event.lost;
+            capture->m_rise_ns = 0;
+            capture->m_fall_ns = 0;
+        }
+
+        if (event.edge == GPIO_EDGE_RISING)
+        {
+            if ((capture->m_fall_ns != 0) && (ts > capture->m_fall_ns))
+                add(capture->m_low, ts - capture->m_fall_ns);
+
+            if ((capture->m_rise_ns != 0) && (ts > capture->m_rise_ns))
+                add(capture->m_period, ts - capture->m_rise_ns);
+
+            capture->m_rise_ns = ts;
+        }
+        else
+        {
+            if ((capture->m_rise_ns != 0) && (ts > capture->m_rise_ns))
+                add(capture->m_high, ts - capture->m_rise_ns);
+
+            capture->m_fall_ns = ts;
+        }
+    }
+
+    capture->m_seq.fetch_add(1, std::memory_order_release);
+}
+
+bool c_capture::read(gpiox_capture_stat& stat)
+{
+    uint32_t seq;
+
+    // retries while reactor thread writes
+    do
+    {
+        seq = m_seq.load(std::memory_order_acquire);
+
+        if (seq & 1)
+            continue;
+
+        get(m_high, stat.high);
+        get(m_low, stat.low);
+        get(m_period, stat.period);
+        stat.periods = m_period.num;
+        stat.lost = m_lost;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    while ((seq & 1) || (seq != m_seq.load(std::memory_order_relaxed)));
+
+    if (stat.periods == 0)
+        return false;
+
+    stat.duty = (stat.period.last_ns > 0) ? (double) stat.high.last_ns / (double) stat.period.last_ns : 0.0;
+
+    if (stat.duty > 1.0)
+        stat.duty = 1.0;
+
+    return true;
+}
+
+static c_capture capture[N_PIN];
+
+// dispatch of callbacks on worker threads
+// reactor thread queues events per pin and puts pin on ready list,
+// one worker at a time takes all queued events of pin, order of pin is kept
+class c_dispatch
+{
+public:
+    c_dispatch()
+    {
+        m_num = 1;
+        m_stop = false;
+        m_ready_head = 0;
+        m_ready_num = 0;
+        m_pins = 0;
+        m_depth = 0;
+        m_depth_max = 0;
+        m_calls = 0;
+        m_latency_max = 0;
+        m_latency_sum = 0;
+        m_latency_num = 0;
+    }
+
+    ~c_dispatch()
+    {
+        stop();
+    }
+
+    bool set_threads(uint32_t num);
+    bool start(uint32_t pin, gpiox_watch_cb cb, void* arg);
+    void cancel(uint32_t pin);
+    void get_stat(gpiox_dispatch_stat& stat, bool reset);
+
+    static void push(const gpiox_event* events, uint32_t num, void* arg);
+
+private:
+    // queue of pin
+    struct s_job
+    {
+        std::mutex mtx;
+        std::condition_variable idle; // signaled after callback
+        std::vector<gpiox_event> events;
+        uint64_t queued_ns; // time of oldest queued event
+        uint32_t lost; // events dropped on full queue
+        bool active; // events are queued
+        bool scheduled; // pin is on ready list
+        bool running; // callback runs
+        gpiox_watch_cb cb;
+        void* arg;
+    };
+
+    void stop();
+    void schedule(uint32_t pin);
+    void loop();
+    void run(uint32_t pin);
+
+    uint32_t m_num; // number of threads
+    bool m_stop;
+    std::mutex m_mtx; // ready list, threads
+    std::condition_variable m_cv; // signaled on ready pin
+    uint32_t m_ready[N_PIN]; // ring of ready pins, pin is once in list
+    uint32_t m_ready_head;
+    uint32_t m_ready_num;
+    uint32_t m_pins; // mask of started pins, m_mtx
+    std::vector<std::thread> m_threads;
+    s_job m_job[N_PIN];
+
+    std::atomic<uint32_t> m_depth;
+    std::atomic<uint32_t> m_depth_max;
+    std::atomic<uint64_t> m_calls;
+    std::atomic<uint64_t> m_latency_max;
+    std::atomic<uint64_t> m_latency_sum;
+    std::atomic<uint64_t> m_latency_num;
+};
+
+// sets number of threads, only if no pin is started
+bool c_dispatch::set_threads(uint32_t num)
+{
+    if ((num == 0) || (num > N_WORKER_MAX))
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        if (m_pins != 0)
+            return false;
+    }
+
+    stop();
+    m_num = num;
+
+    return true;
+}
+
+void c_dispatch::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_stop = true;
+    }
+
+    m_cv.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+
+    m_threads.clear();
+    m_stop = false;
+}
+
+// starts queue of pin, starts threads on first use, pin must not be watched
+bool c_dispatch::start(uint32_t pin, gpiox_watch_cb cb, void* arg)
+{
+    if (cb == nullptr)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        while (m_threads.size() < m_num)
+            m_threads.emplace_back(&c_dispatch::loop, this);
+
+        m_pins |= 1U << pin;
+    }
+
+    s_job& job = m_job[pin];
+
+    std::lock_guard<std::mutex> lock(job.mtx);
+
+    job.cb = cb;
+    job.arg = arg;
+    job.lost = 0;
+    job.active = true;
+
+    return true;
+}
+
+// stops queue of pin, drops queued events and waits for running callback
+void c_dispatch::cancel(uint32_t pin)
+{
+    s_job& job = m_job[pin];
+
+    {
+        std::unique_lock<std::mutex> lock(job.mtx);
+
+        if (!job.active && !job.running)
+            return;
+
+        job.active = false;
+        m_depth -= job.events.size();
+        job.events.clear();
+
+        job.idle.wait(lock, [&job] { return !job.running; });
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_pins &= ~(1U << pin);
+}
+
+// puts pin on ready list, job lock must be held
+void c_dispatch::schedule(uint32_t pin)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        m_ready[(m_ready_head + m_ready_num) % N_PIN] = pin;
+        m_ready_num++;
+    }
+
+    m_cv.notify_one();
+}
+
+// watch callback, runs on reactor thread
+void c_dispatch::push(const gpiox_event* events, uint32_t num, void* arg)
+{
+    c_dispatch* dispatch = static_cast<c_dispatch*>(arg);
+    uint32_t pin = events[0].pin;
+    s_job& job = dispatch->m_job[pin];
+
+    std::lock_guard<std::mutex> lock(job.mtx);
+
+    if (!job.active)
+        return;
+
+    if (job.events.empty())
+        job.queued_ns = get_time_ns();
+
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        job.lost += events[i].lost;
+
+        if (job.events.size() == N_DISPATCH_MAX)
+        {
+            job.lost++;
+            continue;
+        }
+
+        job.events.push_back(events[i]);
+        job.events.back().lost = job.lost;
+        job.lost = 0;
+        n++;
+    }
+
+    uint32_t depth = (dispatch->m_depth += n);
+    uint32_t depth_max = dispatch->m_depth_max.load(std::memory_order_relaxed);
+
+    while ((depth > depth_max) && !dispatch->m_depth_max.compare_exchange_weak(depth_max, depth));
+
+    if (!job.scheduled && !job.running)
+    {
+        job.scheduled = true;
+        dispatch->schedule(pin);
+    }
+}
+
+// runs callback with all queued events of pin, called from worker thread
+void c_dispatch::run(uint32_t pin)
+{
+    s_job& job = m_job[pin];
+    std::vector<gpiox_event> events;
+
+    {
+        std::lock_guard<std::mutex> lock(job.mtx);
+
+        job.scheduled = false;
+
+        if (!job.active || job.events.empty())
+            return;
+
+        events.swap(job.events);
+        job.running = true;
+    }
+
+    uint64_t latency = get_time_ns() - job.queued_ns;
+    uint64_t latency_max = m_latency_max.load(std::memory_order_relaxed);
+
+    while ((latency > latency_max) && !m_latency_max.compare_exchange_weak(latency_max, latency));
+
+    m_latency_sum += latency;
+    m_latency_num++;
+    m_calls++;
+
+    job.cb(events.data(), events.size(), job.arg);
+
+    m_depth -= events.size();
+
+    std::lock_guard<std::mutex> lock(job.mtx);
+
+    job.running = false;
+
+    // events queued while callback was running
+    if (job.active && !job.events.empty())
+    {
+        job.scheduled = true;
+        schedule(pin);
+    }
+
+    job.idle.notify_all();
+}
+
+void c_dispatch::loop()
+{
+    while (true)
+    {
+        uint32_t pin;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+
+            m_cv.wait(lock, [this] { return m_stop || (m_ready_num > 0); });
+
+            if (m_stop)
+                return;
+
+            pin = m_ready[m_ready_head];
+            m_ready_head = (m_ready_head + 1) % N_PIN;
+            m_ready_num--;
+        }
+
+        run(pin);
+    }
+}
+
+void c_dispatch::get_stat(gpiox_dispatch_stat& stat, bool reset)
+{
+    uint64_t num = m_latency_num.load();
+
+    stat.depth = m_depth;
+    stat.depth_max = m_depth_max;
+    stat.calls = m_calls;
+    stat.latency_max_ns = m_latency_max;
+    stat.latency_mean_ns = (num > 0) ? m_latency_sum / num : 0;
+
+    if (!reset)
+        return;
+
+    m_depth_max = stat.depth;
+    m_latency_max = 0;
+    m_latency_sum = 0;
+    m_latency_num = 0;
+}
+
+static c_dispatch dispatch;
+
+// coalescing of events to one callback per interval
+// watch callback and timer run on reactor threads, lock keeps callbacks of pin in order
+class c_coalesce
+{
+public:
+    c_coalesce()
+    {
+        m_tfd = -1;
+        m_pin = 0;
+        m_interval_ns = 0;
+        m_armed = false;
+        m_cb = nullptr;
+        m_arg = nullptr;
+
+        memset(&m_event, 0, sizeof(m_event));
+    }
+
+    ~c_coalesce()
+    {
+        stop();
+    }
+
+    bool start(uint32_t pin, uint32_t interval_ms, gpiox_watch_cb cb, void* arg);
+    void stop();
+
+    static void push(const gpiox_event* events, uint32_t num, void* arg);
+    static void on_timer(void* obj, int32_t fd);
+
+private:
+    void deliver();
+    void arm(uint64_t ns);
+
+    int32_t m_tfd; // interval timer, -1 if stopped
+    uint32_t m_pin;
+    uint64_t m_interval_ns;
+    std::mutex m_mtx;
+    gpiox_event m_event; // last edge, count of pending edges, m_mtx
+    bool m_armed; // interval runs, m_mtx
+    gpiox_watch_cb m_cb;
+    void* m_arg;
+};
+
+// starts timer of pin, pin must not be watched
+bool c_coalesce::start(uint32_t pin, uint32_t interval_ms, gpiox_watch_cb cb, void* arg)
+{
+    if ((cb == nullptr) || (interval_ms == 0) || (interval_ms > WINDOW_MAX_MS))
+        return false;
+
+    stop();
+
+    m_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    if (m_tfd == -1)
+        return false;
+
+    m_pin = pin;
+    m_interval_ns = interval_ms * NS_PER_MS;
+    m_armed = false;
+    m_event.count = 0;
+    m_event.lost = 0;
+    m_cb = cb;
+    m_arg = arg;
+
+    if (!reactor.add(SLOT_TIMER(pin), m_tfd, on_timer, this))
+    {
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+// stops timer, no callback is called after return
+void c_coalesce::stop()
+{
+    if (m_tfd == -1)
+        return;
+
+    reactor.remove(SLOT_TIMER(m_pin));
+    close(m_tfd);
+
+    m_tfd = -1;
+}
+
+// sets one shot timer, 0 disarms, m_mtx must be held
+void c_coalesce::arm(uint64_t ns)
+{
+    itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+
+    its.it_value.tv_sec = ns / NS_PER_S;
+    its.it_value.tv_nsec = ns % NS_PER_S;
+
+    timerfd_settime(m_tfd, 0, &its, nullptr);
+
+    m_armed = (ns != 0);
+}
+
+// calls callback with pending edges and starts interval, m_mtx must be held
+void c_coalesce::deliver()
+{
+    m_cb(&m_event, 1, m_arg);
+
+    m_event.count = 0;
+    m_event.lost = 0;
+
+    arm(m_interval_ns);
+}
+
+// watch callback, runs on reactor thread
+void c_coalesce::push(const gpiox_event* events, uint32_t num, void* arg)
+{
+    c_coalesce* coalesce = static_cast<c_coalesce*>(arg);
+
+    std::lock_guard<std::mutex> lock(coalesce->m_mtx);
+
+    uint32_t count = coalesce->m_event.count;
+    uint32_t lost = coalesce->m_event.lost;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        count += events[i].count;
+        lost += events[i].lost;
+    }
+
+    coalesce->m_event = events[num - 1];
+    coalesce->m_event.count = count;
+    coalesce->m_event.lost = lost;
+
+    // first edge after quiet interval
+    if (!coalesce->m_armed)
+        coalesce->deliver();
+}
+
+// end of interval, runs on reactor thread
+void c_coalesce::on_timer(void* obj, int32_t fd)
+{
+    c_coalesce* coalesce = static_cast<c_coalesce*>(obj);
+    uint64_t expirations;
+
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+
+    std::lock_guard<std::mutex> lock(coalesce->m_mtx);
+
+    if (coalesce->m_event.count > 0)
+        coalesce->deliver();
+    else
+        coalesce->m_armed = false;
+}
+
+static c_coalesce coalesce[N_PIN];
+
+#define QUAD_ERR 2 // illegal transition
+
+// count of transition from state old to new, index old * 4 + new, state is A << 1 | B
+// A leading B is 00 -> 10 -> 11 -> 01 -> 00, events without change are illegal
+static const int8_t quad_table[16] =
+{
+    QUAD_ERR, -1, 1, QUAD_ERR,
+    1, QUAD_ERR, QUAD_ERR, -1,
+    -1, QUAD_ERR, QUAD_ERR, 1,
+    QUAD_ERR, 1, -1, QUAD_ERR
+};
+
+// quadrature encoder with own line request of both pins
+// reactor thread decodes, any thread reads
+class c_encoder
+{
+public:
+    c_encoder()
+    {
+        m_fd = -1;
+        m_encoder = 0;
+        m_state = 0;
+        m_seqno = 0;
+        m_interval_ns = 0;
+        m_ref_ns = 0;
+        m_ref_position = 0;
+        m_cb_position = 0;
+        m_clock = CLOCK_MONOTONIC;
+        m_cb = nullptr;
+        m_arg = nullptr;
+        m_position = 0;
+        m_velocity = 0;
+        m_last_ns = 0;
+        m_errors = 0;
+        m_lost = 0;
+    }
+
+    ~c_encoder()
+    {
+        deinit();
+    }
+
+    bool init(uint32_t encoder, uint32_t pin_a, uint32_t pin_b, uint32_t mode, uint32_t debounce_us,
+        uint32_t interval_ms, gpiox_encoder_cb cb, void* arg);
+    void deinit();
+    bool read(gpiox_encoder_stat& stat);
+    void inject(const gpiox_event& event);
+    bool has_pin(uint32_t pin) { return (m_fd != -1) && ((pin == m_pins[0]) || (pin == m_pins[1])); }
+
+    static void on_ready(void* obj, int32_t fd);
+
+private:
+    void handle(int32_t fd);
+    void process(const gpiox_event* events, uint32_t num);
+
+    int32_t m_fd;
+    uint32_t m_encoder;
+    uint32_t m_pins[2]; // pins of A and B
+    uint32_t m_offset[2]; // chip offsets of A and B
+    uint32_t m_state; // A << 1 | B, reactor thread
+    uint32_t m_seqno; // sequence number of last event, reactor thread
+    uint64_t m_interval_ns;
+    uint64_t m_ref_ns; // start of velocity interval, reactor thread
+    int64_t m_ref_position; // position at start of velocity interval, reactor thread
+    int64_t m_cb_position; // position of last callback, reactor thread
+    clockid_t m_clock; // clock of kernel timestamps
+    gpiox_encoder_cb m_cb;
+    void* m_arg;
+    std::atomic<int64_t> m_position;
+    std::atomic<double> m_velocity;
+    std::atomic<uint64_t> m_last_ns; // timestamp of last event
+    std::atomic<uint32_t> m_errors;
+    std::atomic<uint32_t> m_lost;
+};
+
+bool c_encoder::init(uint32_t encoder, uint32_t pin_a, uint32_t pin_b, uint32_t mode, uint32_t debounce_us,
+    uint32_t interval_ms, gpiox_encoder_cb cb, void* arg)
+{
+    if ((interval_ms == 0) || (interval_ms > WINDOW_MAX_MS) || (pin_a == pin_b))
+        return false;
+
+    deinit();
+
+    // deinit on error below removes slot of this encoder
+    m_encoder = encoder;
+
+    uint32_t pins[2] = { pin_a, pin_b };
+
+    m_fd = gpiox_request(pins, m_offset, 2, mode, debounce_us, GPIO_EDGE_BOTH);
+
+    if (m_fd == -1)
+        return false;
+
+    m_pins[0] = pin_a;
+    m_pins[1] = pin_b;
+
+    // state before first event
+    gpio_v2_line_values line_values;
+    line_values.mask = 3;
+    line_values.bits = 0;
+
+    if (gpiox_get_sys().ioctl(m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) == -1)
+    {
+        deinit();
+        return false;
+    }
+
+    m_state = ((line_values.bits & 1) << 1) | ((line_values.bits >> 1) & 1);
+    m_seqno = 0;
+    m_interval_ns = interval_ms * NS_PER_MS;
+    m_clock = gpiox_get_event_clock() ? CLOCK_REALTIME : CLOCK_MONOTONIC;
+    m_ref_ns = get_time_ns(m_clock);
+    m_ref_position = 0;
+    m_cb_position = 0;
+    m_cb = cb;
+    m_arg = arg;
+    m_position = 0;
+    m_velocity = 0;
+    m_last_ns = 0;
+    m_errors = 0;
+    m_lost = 0;
+
+    if (!reactor.add(SLOT_ENCODER(encoder), m_fd, on_ready, this))
+    {
+        deinit();
+        return false;
+    }
+
+    return true;
+}
+
+void c_encoder::deinit()
+{
+    if (m_fd == -1)
+        return;
+
+    reactor.remove(SLOT_ENCODER(m_encoder));
+    gpiox_release(m_fd);
+
+    m_fd = -1;
+}
+
+void c_encoder::on_ready(void* obj, int32_t fd)
+{
+    static_cast<c_encoder*>(obj)->handle(fd);
+}
+
+// reads events in kernel order, called from reactor thread
+void c_encoder::handle(int32_t fd)
+{
+    gpio_v2_line_event line_events[N_EVENT];
+    gpiox_event events[N_EVENT];
+
+    ssize_t len = gpiox_get_sys().read(fd, line_events, sizeof(line_events));
+
+    if (len < (ssize_t) sizeof(gpio_v2_line_event))
+        return;
+
+    uint32_t num = len / sizeof(gpio_v2_line_event);
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        const gpio_v2_line_event& line_event = line_events[i];
+
+        events[i].timestamp_ns = line_event.timestamp_ns;
+        events[i].pin = (line_event.offset == m_offset[0]) ? m_pins[0] : m_pins[1];
+        events[i].edge = (line_event.id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+        events[i].seqno = line_event.seqno;
+        events[i].line_seqno = line_event.line_seqno;
+        events[i].lost = 0;
+        events[i].count = 1;
+
+        // gap in sequence of request is overflow of kernel buffer
+        if ((m_seqno != 0) && (line_event.seqno > m_seqno + 1))
+            events[i].lost = line_event.seqno - m_seqno - 1;
+
+        m_seqno = line_event.seqno;
+    }
+
+    gpiox_record_write(events, num);
+
+    process(events, num);
+}
+
+// decodes kernel or replayed events, called with slot lock
+void c_encoder::process(const gpiox_event* events, uint32_t num)
+{
+    int64_t position = m_position.load(std::memory_order_relaxed);
+    uint32_t state = m_state;
+    uint32_t errors = 0;
+    uint32_t lost = 0;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        const gpiox_event& event = events[i];
+
+        lost += event.lost;
+
+        uint32_t bit = (event.pin == m_pins[0]) ? 2 : 1;
+        uint32_t next = (event.edge == GPIO_EDGE_RISING) ? (state | bit) : (state & ~bit);
+        int8_t count = quad_table[(state << 2) | next];
+
+        if (count == QUAD_ERR)
+            errors++;
+        else
+            position += count;
+
+        state = next;
+    }
+
+    m_state = state;
+
+    if (errors != 0)
+        m_errors.fetch_add(errors, std::memory_order_relaxed);
+
+    if (lost != 0)
+        m_lost.fetch_add(lost, std::memory_order_relaxed);
+
+    uint64_t ts = events[num - 1].timestamp_ns;
+
+    m_position.store(position, std::memory_order_relaxed);
+    m_last_ns.store(ts, std::memory_order_release);
+
+    // velocity and callback once per interval
+    if ((ts < m_ref_ns) || (ts - m_ref_ns < m_interval_ns))
+        return;
+
+    m_velocity.store((double) (position - m_ref_position) * NS_PER_S / (double) (ts - m_ref_ns), std::memory_order_relaxed);
+    m_ref_ns = ts;
+    m_ref_position = position;
+
+    if ((m_cb == nullptr) || (position == m_cb_position))
+        return;
+
+    m_cb_position = position;
+
+    gpiox_encoder_stat stat;
+
+    read(stat);
+    m_cb(m_encoder, &stat, m_arg);
+}
+
+bool c_encoder::read(gpiox_encoder_stat& stat)
+{
+    if (m_fd == -1)
+        return false;
+
+    uint64_t last_ns = m_last_ns.load(std::memory_order_acquire);
+
+    stat.position = m_position.load(std::memory_order_relaxed);
+    stat.velocity = m_velocity.load(std::memory_order_relaxed);
+    stat.errors = m_errors.load(std::memory_order_relaxed);
+    stat.lost = m_lost.load(std::memory_order_relaxed);
+
+    // no event within interval is standstill
+    if (get_time_ns(m_clock) - last_ns > m_interval_ns)
+        stat.velocity = 0;
+
+    return true;
+}
+
+// passes replayed event as kernel event, serialized with reactor thread of encoder
+void c_encoder::inject(const gpiox_event& event)
+{
+    std::lock_guard<std::mutex> lock(reactor.get_lock(SLOT_ENCODER(m_encoder)));
+
+    if (has_pin(event.pin))
+        process(&event, 1);
+}
+
+static c_encoder encoder[N_ENCODER];
+
+// bank of input pins in one line request with own reactor slot
+class c_bank
+{
+public:
+    c_bank()
+    {
+        m_fd = -1;
+        m_bank = 0;
+        m_num = 0;
+        m_seqno = 0;
+        m_mask = 0;
+        m_cache = false;
+        m_cb = nullptr;
+        m_arg = nullptr;
+    }
+
+    ~c_bank()
+    {
+        deinit();
+    }
+
+    bool init(uint32_t bank, const uint32_t* pins, uint32_t num, uint32_t mode, uint32_t edge,
+        uint32_t debounce_us, gpiox_watch_cb cb, void* arg);
+    void deinit();
+    bool read(uint64_t& bits);
+    void inject(const gpiox_event& event);
+    bool has_pin(uint32_t pin) { return (m_mask.load(std::memory_order_relaxed) >> pin) & 1; }
+
+    static void on_ready(void* obj, int32_t fd);
+
+private:
+    void handle(int32_t fd);
+
+    int32_t m_fd;
+    uint32_t m_bank;
+    uint32_t m_num;
+    uint32_t m_pins[GPIO_V2_LINES_MAX]; // pin of line index
+    uint32_t m_offsets[GPIO_V2_LINES_MAX]; // chip offset of line index
+    uint32_t m_seqno; // sequence number of last event, reactor thread
+    std::atomic<uint64_t> m_mask; // mask of pins
+    bool m_cache; // both edges are read, state of header pins is cached
+    gpiox_watch_cb m_cb;
+    void* m_arg;
+};
+
+bool c_bank::init(uint32_t bank, const uint32_t* pins, uint32_t num, uint32_t mode, uint32_t edge,
+    uint32_t debounce_us, gpiox_watch_cb cb, void* arg)
+{
+    if ((pins == nullptr) || (num == 0) || (num > GPIO_V2_LINES_MAX) || (cb == nullptr) || (edge >= GPIO_EDGE_NONE))
+        return false;
+
+    deinit();
+
+    uint64_t mask = 0;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        if (!CHECKLINE(pins[i]))
+            return false;
+
+        m_pins[i] = pins[i];
+        mask |= 1ULL << pins[i];
+    }
+
+    m_fd = gpiox_request(pins, m_offsets, num, mode, debounce_us, edge);
+
+    if (m_fd == -1)
+        return false;
+
+    m_bank = bank;
+    m_num = num;
+    m_seqno = 0;
+    m_cache = (edge == GPIO_EDGE_BOTH);
+    m_cb = cb;
+    m_arg = arg;
+
+    if (!reactor.add(SLOT_BANK(bank), m_fd, on_ready, this))
+    {
+        deinit();
+        return false;
+    }
+
+    m_mask = mask;
+
+    // seeds cache with one read of all lines, like watch of pin
+    if (m_cache)
+    {
+        std::lock_guard<std::mutex> lock(reactor.get_lock(SLOT_BANK(bank)));
+        uint64_t bits;
+
+        if (read(bits))
+        {
+            for (uint32_t i = 0; i < num; i++)
+                gpiox_cache_seed(m_pins[i], (bits >> i) & 1);
+        }
+    }
+
+    return true;
+}
+
+void c_bank::deinit()
+{
+    if (m_fd == -1)
+        return;
+
+    m_mask = 0;
+
+    reactor.remove(SLOT_BANK(m_bank));
+    gpiox_release(m_fd);
+
+    if (m_cache)
+    {
+        for (uint32_t i = 0; i < m_num; i++)
+            gpiox_cache_clear(m_pins[i]);
+    }
+
+    m_fd = -1;
+}
+
+bool c_bank::read(uint64_t& bits)
+{
+    if (m_fd == -1)
+        return false;
+
+    gpio_v2_line_values line_values;
+    line_values.mask = (m_num == GPIO_V2_LINES_MAX) ? ~0ULL : (1ULL << m_num) - 1;
+    line_values.bits = 0;
+
+    if (gpiox_get_sys().ioctl(m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) == -1)
+        return false;
+
+    bits = line_values.bits;
+
+    return true;
+}
+
+void c_bank::on_ready(void* obj, int32_t fd)
+{
+    static_cast<c_bank*>(obj)->handle(fd);
+}
+
+// reads events of all pins in kernel order, called from reactor thread
+void c_bank::handle(int32_t fd)
+{
+    gpio_v2_line_event line_events[N_EVENT];
+    gpiox_event events[N_EVENT];
+
+    ssize_t len = gpiox_get_sys().read(fd, line_events, sizeof(line_events));
+
+    if (len < (ssize_t) sizeof(gpio_v2_line_event))
+        return;
+
+    uint32_t num = len / sizeof(gpio_v2_line_event);
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        const gpio_v2_line_event& line_event = line_events[i];
+        uint32_t line = 0;
+
+        while ((line < m_num - 1) && (m_offsets[line] != line_event.offset))
+            line++;
+
+        events[i].timestamp_ns = line_event.timestamp_ns;
+        events[i].pin = m_pins[line];
+        events[i].edge = (line_event.id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+        events[i].seqno = line_event.seqno;
+        events[i].line_seqno = line_event.line_seqno;
+        events[i].lost = 0;
+        events[i].count = 1;
+
+        // gap in sequence of request is overflow of kernel buffer
+        if ((m_seqno != 0) && (line_event.seqno > m_seqno + 1))
+            events[i].lost = line_event.seqno - m_seqno - 1;
+
+        m_seqno = line_event.seqno;
+
+        if (m_cache)
+            gpiox_cache_update(events[i].pin, (events[i].edge == GPIO_EDGE_RISING) ? 1 : 0, events[i].timestamp_ns);
+    }
+
+    gpiox_record_write(events, num);
+
+    m_cb(events, num, m_arg);
+}
+
+// passes replayed event as kernel event, serialized with reactor thread of bank
+void c_bank::inject(const gpiox_event& event)
+{
+    std::lock_guard<std::mutex> lock(reactor.get_lock(SLOT_BANK(m_bank)));
+
+    if (has_pin(event.pin))
+        m_cb(&event, 1, m_arg);
+}
+
+static c_bank bank[N_BANK];
+
+// watches are destroyed before queues, counters, captures and dispatch
+static c_watch watch[N_PIN];
+static std::atomic<uint32_t> watch_pins(0); // mask of watched pins
+static std::atomic<uint32_t> mirror_pins(0); // mask of mirrored pins
+
+// sets number of threads, only if no slot is registered
+bool c_reactor::set_threads(uint32_t num)
+{
+    if ((num == 0) || (num > N_THREAD_MAX))
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (m_slots != 0)
+        return false;
+
+    stop();
+    m_num = num;
+
+    return true;
+}
+
+// starts threads, m_mtx must be held
+bool c_reactor::start()
+{
+    if (m_epfd != -1)
+        return true;
+
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    m_efd = eventfd(0, EFD_CLOEXEC);
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_STOP;
+
+    if ((m_epfd == -1) || (m_efd == -1) || (epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_efd, &ev) == -1))
+    {
+        stop();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < m_num; i++)
+        m_threads.emplace_back(&c_reactor::loop, this);
+
+    return true;
+}
+
+// stops threads, m_mtx must be held or reactor is destroyed
+void c_reactor::stop()
+{
+    if (!m_threads.empty())
+    {
+        uint64_t val = 1;
+
+        // stop event stays set and wakes all threads
+        if (write(m_efd, &val, sizeof(val)) == sizeof(val))
+        {
+            for (std::thread& thread : m_threads)
+                thread.join();
+        }
+        else
+        {
+            for (std::thread& thread : m_threads)
+                thread.detach();
+        }
+
+        m_threads.clear();
+    }
+
+    if (m_efd != -1)
+        close(m_efd);
+
+    if (m_epfd != -1)
+        close(m_epfd);
+
+    m_efd = -1;
+    m_epfd = -1;
+}
+
+// registers line fd in slot, starts threads on first use
+bool c_reactor::add(uint32_t index, int32_t fd, reactor_fn fn, void* obj)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (!start())
+        return false;
+
+    s_slot& slot = m_slot[index];
+
+    slot.fd = fd;
+    slot.fn = fn;
+    slot.obj = obj;
+
+    epoll_event ev;
+    ev.events = get_flags();
+    ev.data.u64 = index | ((uint64_t) ++slot.gen << 32);
+
+    if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+        return false;
+
+    m_slots |= 1ULL << index;
+
+    return true;
+}
+
+// unregisters slot and waits for running dispatch of slot
+void c_reactor::remove(uint32_t index)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if ((m_slots & (1ULL << index)) == 0)
+        return;
+
+    s_slot& slot = m_slot[index];
+
+    epoll_ctl(m_epfd, EPOLL_CTL_DEL, slot.fd, nullptr);
+    slot.gen++;
+    m_slots &= ~(1ULL << index);
+
+    // events already taken from epoll see changed generation
+    std::lock_guard<std::mutex> wait(slot.mtx);
+
+    slot.fd = -1;
+}
+
+void c_reactor::dispatch(uint64_t data, uint32_t events)
+{
+    uint32_t index = (uint32_t) data;
+    uint32_t gen = (uint32_t) (data >> 32);
+
+    s_slot& slot = m_slot[index];
+
+    std::lock_guard<std::mutex> lock(slot.mtx);
+
+    // slot removed or registered again
+    if (slot.gen != gen)
+        return;
+
+    // line released, slot stays registered until removed
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        epoll_ctl(m_epfd, EPOLL_CTL_DEL, slot.fd, nullptr);
+        return;
+    }
+
+    slot.fn(slot.obj, slot.fd);
+
+    // rearms one shot fd of pool
+    if (m_num > 1)
+    {
+        epoll_event ev;
+        ev.events = get_flags();
+        ev.data.u64 = data;
+
+        epoll_ctl(m_epfd, EPOLL_CTL_MOD, slot.fd, &ev);
+    }
+}
+
+void c_reactor::loop()
+{
+    epoll_event evs[N_READY];
+
+    while (true)
+    {
+        int n = epoll_wait(m_epfd, evs, N_READY, -1);
+
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            break;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (evs[i].data.u64 == REACTOR_STOP)
+                return;
+
+            dispatch(evs[i].data.u64, evs[i].events);
+        }
+    }
+}
+
+bool gpiox_watch_threads(uint32_t num)
+{
+    return reactor.set_threads(num);
+}
+
+// sets callback of watch, pin must be checked
+static bool watch_pin(uint32_t pin, uint32_t edge, uint32_t debounce_us, gpiox_watch_cb cb, void* arg)
+{
+    if (!watch[pin].set_watch(pin, edge, debounce_us, cb, arg))
+    {
+        watch_pins &= ~(1U << pin);
+        return false;
+    }
+
+    watch_pins |= 1U << pin;
+
+    return true;
+}
+
+bool gpiox_watch(uint32_t pin, uint32_t edge, uint32_t debounce_us, gpiox_watch_cb cb, void* arg)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    bool ok = watch_pin(pin, edge, debounce_us, cb, arg);
+
+    // no async or coalesced callback after return
+    dispatch.cancel(pin);
+    coalesce[pin].stop();
+
+    return ok;
+}
+
+bool gpiox_watch_async(uint32_t pin, uint32_t edge, uint32_t debounce_us, gpiox_watch_cb cb, void* arg)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    gpiox_unwatch(pin);
+
+    if (!dispatch.start(pin, cb, arg))
+        return false;
+
+    if (watch_pin(pin, edge, debounce_us, c_dispatch::push, &dispatch))
+        return true;
+
+    dispatch.cancel(pin);
+
+    return false;
+}
+
+bool gpiox_watch_coalesce(uint32_t pin, uint32_t edge, uint32_t debounce_us, uint32_t interval_ms, gpiox_watch_cb cb, void* arg)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    gpiox_unwatch(pin);
+
+    if (!coalesce[pin].start(pin, interval_ms, cb, arg))
+        return false;
+
+    if (watch_pin(pin, edge, debounce_us, c_coalesce::push, &coalesce[pin]))
+        return true;
+
+    coalesce[pin].stop();
+
+    return false;
+}
+
+bool gpiox_watch_bank(uint32_t b, const uint32_t* pins, uint32_t num, uint32_t mode, uint32_t edge,
+    uint32_t debounce_us, gpiox_watch_cb cb, void* arg)
+{
+    if (!CHECKBANK(b))
+        return false;
+
+    return bank[b].init(b, pins, num, mode, edge, debounce_us, cb, arg);
+}
+
+bool gpiox_unwatch_bank(uint32_t b)
+{
+    if (!CHECKBANK(b))
+        return false;
+
+    bank[b].deinit();
+
+    return true;
+}
+
+bool gpiox_bank_read(uint32_t b, uint64_t& bits)
+{
+    if (!CHECKBANK(b))
+        return false;
+
+    return bank[b].read(bits);
+}
+
+bool gpiox_dispatch_threads(uint32_t num)
+{
+    return dispatch.set_threads(num);
+}
+
+void gpiox_dispatch_status(gpiox_dispatch_stat& stat, bool reset)
+{
+    dispatch.get_stat(stat, reset);
+}
+
+bool gpiox_watch_queue(uint32_t pin, uint32_t edge, uint32_t debounce_us, uint32_t size)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    // no push after unwatch
+    gpiox_unwatch(pin);
+
+    if (!queue[pin].init(size))
+        return false;
+
+    return gpiox_watch(pin, edge, debounce_us, c_queue::push, &queue[pin]);
+}
+
+uint32_t gpiox_watch_pop(uint32_t pin, gpiox_event* events, uint32_t num)
+{
+    if (!CHECKPIN(pin) || (events == nullptr))
+        return 0;
+
+    return queue[pin].pop(events, num);
+}
+
+bool gpiox_count(uint32_t pin, uint32_t edge, uint32_t debounce_us, uint32_t window_ms)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    // no count after unwatch
+    gpiox_unwatch(pin);
+
+    if (!counter[pin].init(window_ms))
+        return false;
+
+    return gpiox_watch(pin, edge, debounce_us, c_counter::push, &counter[pin]);
+}
+
+bool gpiox_count_read(uint32_t pin, gpiox_count_stat& stat)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    return counter[pin].read(stat);
+}
+
+bool gpiox_capture(uint32_t pin, uint32_t debounce_us)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    // no capture after unwatch
+    gpiox_unwatch(pin);
+
+    capture[pin].reset();
+
+    return gpiox_watch(pin, GPIO_EDGE_BOTH, debounce_us, c_capture::push, &capture[pin]);
+}
+
+bool gpiox_capture_read(uint32_t pin, gpiox_capture_stat& stat)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    return capture[pin].read(stat);
+}
+
+bool gpiox_unwatch(uint32_t pin)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    if ((watch_pins & (1U << pin)) == 0)
+        return true;
+
+    watch[pin].clear_watch(pin);
+    watch_pins &= ~(1U << pin);
+
+    dispatch.cancel(pin);
+    coalesce[pin].stop();
+
+    return true;
+}
+
+// pace of replay
+struct s_replay
+{
+    bool realtime;
+    uint64_t first_ns; // timestamp of first event
+    uint64_t start_ns; // monotonic time of first event
+};
+
+// replays events of one segment, runs on thread of gpiox_replay
+static bool replay_events(const gpiox_event* events, uint32_t num, void* arg)
+{
+    s_replay* replay = static_cast<s_replay*>(arg);
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        const gpiox_event& event = events[i];
+
+        if (!CHECKLINE(event.pin))
+            continue;
+
+        if (replay->realtime)
+        {
+            if (replay->start_ns == 0)
+            {
+                replay->first_ns = event.timestamp_ns;
+                replay->start_ns = get_time_ns();
+            }
+
+            // waits until original time of event
+            if (event.timestamp_ns > replay->first_ns)
+            {
+                uint64_t ns = replay->start_ns + (event.timestamp_ns - replay->first_ns);
+
+                timespec ts;
+                ts.tv_sec = ns / NS_PER_S;
+                ts.tv_nsec = ns % NS_PER_S;
+
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+            }
+        }
+
+        if (CHECKPIN(event.pin) && ((watch_pins | mirror_pins) & (1U << event.pin)))
+            watch[event.pin].inject(event);
+
+        for (uint32_t b = 0; b < N_BANK; b++)
+        {
+            if (bank[b].has_pin(event.pin))
+                bank[b].inject(event);
+        }
+
+        for (uint32_t e = 0; e < N_ENCODER; e++)
+        {
+            if (encoder[e].has_pin(event.pin))
+                encoder[e].inject(event);
+        }
+    }
+
+    return true;
+}
+
+bool gpiox_replay(const char* path, bool realtime)
+{
+    s_replay replay;
+
+    replay.realtime = realtime;
+    replay.first_ns = 0;
+    replay.start_ns = 0;
+
+    return gpiox_record_read(path, replay_events, &replay);
+}
+
+bool gpiox_mirror(uint32_t pin, uint32_t debounce_us, int32_t* state, gpiox_mirror_cb cb, void* arg)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    if (!watch[pin].set_mirror(pin, debounce_us, state, cb, arg))
+    {
+        mirror_pins &= ~(1U << pin);
+        return false;
+    }
+
+    mirror_pins |= 1U << pin;
+
+    return true;
+}
+
+bool gpiox_unmirror(uint32_t pin)
+{
+    if (!CHECKPIN(pin))
+        return false;
+
+    if ((mirror_pins & (1U << pin)) == 0)
+        return true;
+
+    watch[pin].clear_mirror(pin);
+    mirror_pins &= ~(1U << pin);
+
+    return true;
+}
+
+bool gpiox_encoder_init(uint32_t enc, uint32_t pin_a, uint32_t pin_b, uint32_t mode, uint32_t debounce_us,
+    uint32_t interval_ms, gpiox_encoder_cb cb, void* arg)
+{
+    if (!CHECKENCODER(enc))
+        return false;
+
+    return encoder[enc].init(enc, pin_a, pin_b, mode, debounce_us, interval_ms, cb, arg);
+}
+
+bool gpiox_encoder_deinit(uint32_t enc)
+{
+    if (!CHECKENCODER(enc))
+        return false;
+
+    encoder[enc].deinit();
+
+    return true;
+}
+
+bool gpiox_encoder_read(uint32_t enc, gpiox_encoder_stat& stat)
+{
+    if (!CHECKENCODER(enc))
+        return false;
+
+    return encoder[enc].read(stat);
+}
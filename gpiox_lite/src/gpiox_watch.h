@@ -0,0 +1,342 @@
+/*
+ * gpiox watch functions
+ *
+ * (c) Derya Y. iiot2k@gmail.com
+ *
+ * gpiox_watch.h
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define N_BANK 4 // max. banks of gpiox_watch_bank
+
+/**
+ * @brief edge event of watched pin
+ */
+struct gpiox_event
+{
+    uint64_t timestamp_ns; // kernel time of event, CLOCK_MONOTONIC or CLOCK_REALTIME (see gpiox_set_event_clock)
+    uint32_t pin;          // gpio pin
+    uint32_t edge;         // GPIO_EDGE_RISING or GPIO_EDGE_FALLING
+    uint32_t seqno;        // sequence number of event in line request
+    uint32_t line_seqno;   // sequence number of event on line
+    uint32_t lost;         // events dropped by kernel since event before
+    uint32_t count;        // edges represented by event, > 1 if coalesced (see gpiox_watch_coalesce)
+};
+
+/**
+ * @brief watch callback function, called from reactor thread
+ * @param events array of events in kernel order
+ * @param num number of events in array
+ * @param arg argument of gpiox_watch
+ */
+typedef void (*gpiox_watch_cb)(const gpiox_event* events, uint32_t num, void* arg);
+
+/**
+ * @brief watches edges of initialized input pin
+ * @param pin pin number (0..27)
+ * @param edge GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param cb callback function, receives all events read at once
+ * @param arg argument for callback function
+ * @returns false on error, true on ok
+ * @note state of pin after event is 1 on GPIO_EDGE_RISING and 0 on GPIO_EDGE_FALLING
+ * @note callbacks of one pin are called in order, never at same time
+ * @note events dropped on kernel buffer overflow are counted in lost of next event (see gpiox_set_event_buffer)
+ */
+bool gpiox_watch(uint32_t pin, uint32_t edge, uint32_t debounce_us, gpiox_watch_cb cb, void* arg);
+
+/**
+ * @brief stops watch of pin
+ * @param pin pin number (0..27)
+ * @returns false on error, true on ok
+ * @note no callback is called after return, must not be called from callback
+ */
+bool gpiox_unwatch(uint32_t pin);
+
+/**
+ * @brief watches edges of initialized input pin, callback runs on dispatch thread
+ * @param pin pin number (0..27)
+ * @param edge GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param cb callback function, receives all events queued since last call
+ * @param arg argument for callback function
+ * @returns false on error, true on ok
+ * @note reactor thread queues events, slow callback does not stop reading of kernel events
+ * @note callbacks of one pin are called in order, never at same time
+ * @note up to 4096 events are queued per pin, more events are counted in lost of next event
+ */
+bool gpiox_watch_async(uint32_t pin, uint32_t edge, uint32_t debounce_us, gpiox_watch_cb cb, void* arg);
+
+/**
+ * @brief watches edges of initialized input pin with at most one callback per interval
+ * @param pin pin number (0..27)
+ * @param edge GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param interval_ms min. time between callbacks in ms (1..60000)
+ * @param cb callback function, receives one event
+ * @param arg argument for callback function
+ * @returns false on error, true on ok
+ * @note first edge after quiet interval is delivered at once, later edges are coalesced until interval ends
+ * @note event is last edge, count is number of coalesced edges, kernel events are read at full speed
+ */
+bool gpiox_watch_coalesce(uint32_t pin, uint32_t edge, uint32_t debounce_us, uint32_t interval_ms, gpiox_watch_cb cb, void* arg);
+
+/**
+ * @brief watches bank of input pins with same settings in one line request
+ * @param bank bank number (0..3)
+ * @param pins array of pin numbers (0..63), all lines on same chip, pins must not be initialized
+ * @param num number of pins (1..64)
+ * @param mode input mode of all pins (see gpiox_def.h)
+ * @param edge GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param cb callback function, receives events of all pins
+ * @param arg argument for callback function
+ * @returns false on error, true on ok
+ * @note one fd and one reactor slot for all pins, events of all pins are in kernel order of seqno
+ * @note lost counts events dropped on all pins of bank
+ */
+bool gpiox_watch_bank(uint32_t bank, const uint32_t* pins, uint32_t num, uint32_t mode, uint32_t edge,
+    uint32_t debounce_us, gpiox_watch_cb cb, void* arg);
+
+/**
+ * @brief stops watch of bank and releases pins
+ * @param bank bank number (0..3)
+ * @returns false on error, true on ok
+ * @note no callback is called after return, must not be called from callback
+ */
+bool gpiox_unwatch_bank(uint32_t bank);
+
+/**
+ * @brief reads state of all pins of bank with one ioctl
+ * @param bank bank number (0..3)
+ * @param bits receives state of pins, bit n is pins[n] of gpiox_watch_bank
+ * @returns false on error, true on ok
+ */
+bool gpiox_bank_read(uint32_t bank, uint64_t& bits);
+
+/**
+ * @brief statistic of dispatch threads
+ */
+struct gpiox_dispatch_stat
+{
+    uint32_t depth;           // events queued now
+    uint32_t depth_max;       // max. events queued
+    uint64_t calls;           // callbacks called
+    uint64_t latency_max_ns;  // max. time from queue of event to call
+    uint64_t latency_mean_ns; // mean time from queue of event to call
+};
+
+/**
+ * @brief sets number of dispatch threads for gpiox_watch_async
+ * @param num number of threads (1..8), default 1
+ * @returns false on error or if any pin is watched by gpiox_watch_async, true on ok
+ * @note callbacks of different pins can run at same time with more than one thread
+ */
+bool gpiox_dispatch_threads(uint32_t num);
+
+/**
+ * @brief reads statistic of dispatch threads
+ * @param stat receives statistic
+ * @param reset true resets max. values and mean
+ */
+void gpiox_dispatch_status(gpiox_dispatch_stat& stat, bool reset);
+
+/**
+ * @brief watches edges of initialized input pin into queue for gpiox_watch_pop
+ * @param pin pin number (0..27)
+ * @param edge GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param size number of events in queue, rounded up to power of 2 (max. 65536)
+ * @returns false on error, true on ok
+ * @note replaces callback of gpiox_watch, stops with gpiox_unwatch
+ * @note events on full queue are dropped and counted in lost of next queued event
+ */
+bool gpiox_watch_queue(uint32_t pin, uint32_t edge, uint32_t debounce_us, uint32_t size);
+
+/**
+ * @brief takes events from queue of pin without blocking
+ * @param pin pin number (0..27)
+ * @param events array receives events in kernel order
+ * @param num size of array
+ * @returns number of events received, 0 if queue is empty
+ * @note one thread may take events of one pin, lock-free with reactor thread
+ */
+uint32_t gpiox_watch_pop(uint32_t pin, gpiox_event* events, uint32_t num);
+
+/**
+ * @brief statistic of edge counter
+ */
+struct gpiox_count_stat
+{
+    uint64_t count;     // counted edges since start
+    double rate;        // counted edges per second over window
+    uint64_t period_ns; // time between last two counted edges, 0 before second edge
+    uint32_t lost;      // events dropped by kernel since start
+};
+
+/**
+ * @brief counts edges of initialized input pin without callback
+ * @param pin pin number (0..27)
+ * @param edge GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param window_ms sliding window of rate in ms (1..60000)
+ * @returns false on error, true on ok
+ * @note replaces callback of gpiox_watch, stops with gpiox_unwatch
+ * @note edges are counted on kernel timestamps, window is moved in steps of window_ms / 16
+ */
+bool gpiox_count(uint32_t pin, uint32_t edge, uint32_t debounce_us, uint32_t window_ms);
+
+/**
+ * @brief reads statistic of edge counter
+ * @param pin pin number (0..27)
+ * @param stat receives statistic
+ * @returns false on error, true on ok
+ * @note lock-free with reactor thread, can be called from any thread
+ */
+bool gpiox_count_read(uint32_t pin, gpiox_count_stat& stat);
+
+/**
+ * @brief statistic of captured time
+ */
+struct gpiox_time_stat
+{
+    uint64_t last_ns; // last captured time
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t mean_ns;
+};
+
+/**
+ * @brief statistic of pulse capture
+ */
+struct gpiox_capture_stat
+{
+    gpiox_time_stat high;   // time from rising to falling edge
+    gpiox_time_stat low;    // time from falling to rising edge
+    gpiox_time_stat period; // time between rising edges
+    double duty;            // last high time / last period (0..1)
+    uint64_t periods;       // number of captured periods
+    uint32_t lost;          // events dropped by kernel
+};
+
+/**
+ * @brief captures pulse width and period of initialized input pin without callback
+ * @param pin pin number (0..27)
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @returns false on error, true on ok
+ * @note replaces callback of gpiox_watch, stops with gpiox_unwatch
+ * @note rising and falling kernel timestamps are paired, pairing restarts after lost events
+ */
+bool gpiox_capture(uint32_t pin, uint32_t debounce_us);
+
+/**
+ * @brief reads statistic of pulse capture
+ * @param pin pin number (0..27)
+ * @param stat receives statistic, all values of same event
+ * @returns false on error or before first period, true on ok
+ * @note lock-free with reactor thread, can be called from any thread
+ */
+bool gpiox_capture_read(uint32_t pin, gpiox_capture_stat& stat);
+
+/**
+ * @brief state of quadrature encoder
+ */
+struct gpiox_encoder_stat
+{
+    int64_t position; // counts, 4 counts per cycle, A leading B counts up
+    double velocity;  // counts per second over interval, 0 if stopped
+    uint32_t errors;  // illegal transitions (missed edges)
+    uint32_t lost;    // events dropped by kernel
+};
+
+/**
+ * @brief encoder callback function, called from reactor thread
+ * @param encoder encoder number
+ * @param stat state of encoder
+ * @param arg argument of gpiox_encoder_init
+ */
+typedef void (*gpiox_encoder_cb)(uint32_t encoder, const gpiox_encoder_stat* stat, void* arg);
+
+/**
+ * @brief initializes quadrature encoder on two pins in one line request
+ * @param encoder encoder number (0..3)
+ * @param pin_a pin number of channel A, pins must not be initialized
+ * @param pin_b pin number of channel B, on same chip as A
+ * @param mode input mode of both pins (see gpiox_def.h)
+ * @param debounce_us debounce-time in us, 0 disables debounce
+ * @param interval_ms velocity interval and min. time between callbacks in ms (1..60000)
+ * @param cb callback function called after position has changed, can be nullptr
+ * @param arg argument for callback function
+ * @returns false on error, true on ok
+ * @note decoded on reactor thread from kernel events of both edges on both pins
+ */
+bool gpiox_encoder_init(uint32_t encoder, uint32_t pin_a, uint32_t pin_b, uint32_t mode, uint32_t debounce_us,
+    uint32_t interval_ms, gpiox_encoder_cb cb, void* arg);
+
+/**
+ * @brief de-initializes encoder and releases pins
+ * @param encoder encoder number (0..3)
+ * @returns false on error, true on ok
+ * @note no callback is called after return, must not be called from callback
+ */
+bool gpiox_encoder_deinit(uint32_t encoder);
+
+/**
+ * @brief reads state of encoder
+ * @param encoder encoder number (0..3)
+ * @param stat receives state
+ * @returns false on error, true on ok
+ * @note lock-free with reactor thread, can be called from any thread
+ */
+bool gpiox_encoder_read(uint32_t encoder, gpiox_encoder_stat& stat);
+
+/**
+ * @brief mirror callback function, called from reactor thread after state of pin is changed
+ * @param pin gpio pin
+ * @param arg argument of gpiox_mirror
+ */
+typedef void (*gpiox_mirror_cb)(uint32_t pin, void* arg);
+
+/**
+ * @brief mirrors state of initialized input pin to memory
+ * @param pin pin number (0..27)
+ * @param debounce_us debounce-time in us, 0 disables debounce, debounce of gpiox_watch has priority
+ * @param state array of N_PIN + 1 elements, state[pin] receives state 0/1, state[N_PIN] is incremented on change
+ * @param cb callback function called after change, can be nullptr
+ * @param arg argument for callback function
+ * @returns false on error, true on ok
+ * @note state is written atomic, state array must be valid until gpiox_unmirror
+ * @note pin can be watched and mirrored
+ */
+bool gpiox_mirror(uint32_t pin, uint32_t debounce_us, int32_t* state, gpiox_mirror_cb cb, void* arg);
+
+/**
+ * @brief stops mirror of pin
+ * @param pin pin number (0..27)
+ * @returns false on error, true on ok
+ * @note state array is not written after return
+ */
+bool gpiox_unmirror(uint32_t pin);
+
+/**
+ * @brief sets number of reactor threads for all watched and mirrored pins
+ * @param num number of threads (1..4), default 1
+ * @returns false on error or if any pin is watched or mirrored, true on ok
+ * @note with more than one thread callbacks of different pins can run at same time
+ */
+bool gpiox_watch_threads(uint32_t num);
+
+/**
+ * @brief replays recorded log through watches of pins (see gpiox_record_start)
+ * @param path file name of log
+ * @param realtime true replays with original time between events, false as fast as possible
+ * @returns false on error, true on ok
+ * @note events are passed to callbacks, mirrors, queues, counters, captures, banks and encoders as kernel events of watched pins
+ * @note runs on calling thread until end of log, pins without watch are skipped
+ * @note on machines without gpio chip pins can be watched on simulated chip (see gpiox_set_sys)
+ */
+bool gpiox_replay(const char* path, bool realtime);
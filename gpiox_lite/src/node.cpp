@@ -10,8 +10,15 @@
 #include <napi.h>
 using namespace Napi;
 
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "gpiox.h"
 #include "gpiox_def.h"
+#include "gpiox_watch.h"
+#include "gpiox_record.h"
 
 Value chip_name(const CallbackInfo &info)
 {
@@ -23,12 +30,159 @@ Value chip_label(const CallbackInfo &info)
     return String::New(info.Env(), gpiox_get_chiplabel());
 }
 
+// watch of pin with js callback
+// events are queued by watch thread, one js call delivers all queued events
+struct s_watch_js
+{
+    ThreadSafeFunction tsfn;
+    std::mutex mtx;
+    std::vector<gpiox_event> queue;
+    bool posted; // js call is pending
+};
+
+static s_watch_js* watch_js[N_PIN];
+
+// calls js callback with array of queued events, runs on js thread
+static void call_watch_js(Env env, Function cb, s_watch_js* watch)
+{
+    std::vector<gpiox_event> events;
+
+    {
+        std::lock_guard<std::mutex> lock(watch->mtx);
+        events.swap(watch->queue);
+        watch->posted = false;
+    }
+
+    if ((env == nullptr) || (cb == nullptr) || events.empty())
+        return;
+
+    Array arr = Array::New(env, events.size());
+
+    for (uint32_t i = 0; i < events.size(); i++)
+    {
+        Object obj = Object::New(env);
+
+        obj.Set("pin", Number::New(env, events[i].pin));
+        obj.Set("edge", Number::New(env, events[i].edge));
+        obj.Set("state", Boolean::New(env, events[i].edge == GPIO_EDGE_RISING));
+        obj.Set("timestamp", BigInt::New(env, events[i].timestamp_ns));
+        obj.Set("seqno", Number::New(env, events[i].seqno));
+        obj.Set("line_seqno", Number::New(env, events[i].line_seqno));
+        obj.Set("lost", Number::New(env, events[i].lost));
+        obj.Set("count", Number::New(env, events[i].count));
+
+        arr[i] = obj;
+    }
+
+    cb.Call({ arr });
+}
+
+// queues events, runs on watch thread
+static void on_watch(const gpiox_event* events, uint32_t num, void* arg)
+{
+    s_watch_js* watch = static_cast<s_watch_js*>(arg);
+
+    std::lock_guard<std::mutex> lock(watch->mtx);
+
+    watch->queue.insert(watch->queue.end(), events, events + num);
+
+    if (watch->posted)
+        return;
+
+    if (watch->tsfn.NonBlockingCall(watch, call_watch_js) == napi_ok)
+        watch->posted = true;
+}
+
+// stops watch and releases js callback
+static void release_watch(uint32_t pin)
+{
+    if ((pin >= N_PIN) || (watch_js[pin] == nullptr))
+        return;
+
+    gpiox_unwatch(pin);
+
+    // watch is deleted on finalize after pending js calls
+    watch_js[pin]->tsfn.Release();
+    watch_js[pin] = nullptr;
+}
+
+static s_watch_js* bank_js[N_BANK];
+
+// stops watch of bank and releases js callback
+static void release_bank(uint32_t bank)
+{
+    if ((bank >= N_BANK) || (bank_js[bank] == nullptr))
+        return;
+
+    gpiox_unwatch_bank(bank);
+
+    bank_js[bank]->tsfn.Release();
+    bank_js[bank] = nullptr;
+}
+
+// state mirror of pins in Int32Array
+// elements 0..27 holds pin state, element 28 is incremented on change and notified
+struct s_mirror_js
+{
+    ThreadSafeFunction tsfn; // calls Atomics.notify
+    ObjectReference state;   // keeps array alive
+    int32_t* data;
+    std::atomic<bool> posted; // notify is pending
+};
+
+static s_mirror_js* mirror_js = nullptr;
+static uint32_t mirror_mask = 0;
+
+// notifies waiters on change counter, runs on js thread
+static void call_mirror_js(Env env, Function notify, s_mirror_js* mirror)
+{
+    mirror->posted = false;
+
+    if ((env == nullptr) || (notify == nullptr))
+        return;
+
+    notify.Call({ mirror->state.Value(), Number::New(env, N_PIN) });
+}
+
+// posts notify, runs on watch thread
+static void on_mirror(uint32_t, void* arg)
+{
+    s_mirror_js* mirror = static_cast<s_mirror_js*>(arg);
+
+    if (mirror->posted.exchange(true))
+        return;
+
+    if (mirror->tsfn.NonBlockingCall(mirror, call_mirror_js) != napi_ok)
+        mirror->posted = false;
+}
+
+// stops mirror of all pins and releases array
+static void release_mirror()
+{
+    if (mirror_js == nullptr)
+        return;
+
+    for (uint32_t pin = 0; pin < N_PIN; pin++)
+        if (mirror_mask & (1U << pin))
+            gpiox_unmirror(pin);
+
+    mirror_mask = 0;
+
+    // mirror is deleted on finalize after pending js calls
+    mirror_js->tsfn.Release();
+    mirror_js = nullptr;
+}
+
 Value init_gpio(const CallbackInfo &info)
 {
     uint32_t pin    = info[0].ToNumber().Uint32Value();
     uint32_t mode   = info[1].ToNumber().Uint32Value();
     uint32_t setval = info[2].ToNumber().Uint32Value();
 
+    // gpiox_init stops watch and mirror
+    release_watch(pin);
+    mirror_mask &= ~(1U << (pin & 31));
+
     return Boolean::New(info.Env(), gpiox_init(pin, mode, setval));
 }
 
@@ -36,6 +190,10 @@ Value deinit_gpio(const CallbackInfo &info)
 {
     uint32_t pin = info[0].ToNumber().Uint32Value();
 
+    // gpiox_deinit stops watch and mirror
+    release_watch(pin);
+    mirror_mask &= ~(1U << (pin & 31));
+
     return Boolean::New(info.Env(), gpiox_deinit(pin));
 }
 
@@ -50,6 +208,21 @@ Value get_gpio(const CallbackInfo &info)
     return Boolean::New(info.Env(), val > 0);
 }
 
+// returns object with state bitmap and bitmap of cached pins, watched pins are read without syscall
+Value get_gpio_all(const CallbackInfo &info)
+{
+    Env env = info.Env();
+    uint32_t bits;
+    uint32_t mask = gpiox_read_all(bits);
+
+    Object obj = Object::New(env);
+
+    obj.Set("bits", Number::New(env, bits & mask));
+    obj.Set("mask", Number::New(env, mask));
+
+    return obj;
+}
+
 Value set_gpio(const CallbackInfo &info)
 {
     uint32_t pin = info[0].ToNumber().Uint32Value();
@@ -58,6 +231,367 @@ Value set_gpio(const CallbackInfo &info)
     return Boolean::New(info.Env(), gpiox_write(pin, val));
 }
 
+// reads pins of array, fills optional Uint8Array with states
+// returns bitmap with bit n for pin n
+Value read_gpios(const CallbackInfo &info)
+{
+    if (!info[0].IsArray())
+        return info.Env().Undefined();
+
+    Array pins = info[0].As<Array>();
+    uint32_t n = pins.Length();
+    uint32_t mask = 0;
+
+    if (n > 32)
+        return info.Env().Undefined();
+
+    uint8_t pin_nr[32];
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Value pin = pins[i];
+
+        if (!pin.IsNumber())
+            return info.Env().Undefined();
+
+        uint32_t nr = pin.As<Number>().Uint32Value();
+
+        if (nr >= 32)
+            return info.Env().Undefined();
+
+        pin_nr[i] = nr;
+        mask |= 1U << nr;
+    }
+
+    uint32_t bits;
+
+    if (!gpiox_read_mask(mask, bits))
+        return info.Env().Undefined();
+
+    if (info[1].IsTypedArray() && (info[1].As<TypedArray>().TypedArrayType() == napi_uint8_array))
+    {
+        Uint8Array states = info[1].As<Uint8Array>();
+        uint32_t len = (states.ElementLength() < n) ? states.ElementLength() : n;
+
+        for (uint32_t i = 0; i < len; i++)
+            states[i] = (bits >> pin_nr[i]) & 1;
+    }
+
+    return Number::New(info.Env(), bits);
+}
+
+// writes bits of mask, bit n is pin n
+Value write_gpios(const CallbackInfo &info)
+{
+    uint32_t mask = info[0].ToNumber().Uint32Value();
+    uint32_t bits = info[1].ToNumber().Uint32Value();
+
+    return Boolean::New(info.Env(), gpiox_write_mask(mask, bits));
+}
+
+// watches input, callback receives array of events
+// optional interval in ms coalesces events to one callback per interval
+Value watch_gpio(const CallbackInfo &info)
+{
+    uint32_t pin      = info[0].ToNumber().Uint32Value();
+    uint32_t edge     = info[1].ToNumber().Uint32Value();
+    uint32_t debounce = info[2].ToNumber().Uint32Value();
+    uint32_t interval = info[4].IsNumber() ? info[4].As<Number>().Uint32Value() : 0;
+
+    if ((pin >= N_PIN) || !info[3].IsFunction())
+        return Boolean::New(info.Env(), false);
+
+    release_watch(pin);
+
+    s_watch_js* watch = new s_watch_js();
+    watch->posted = false;
+
+    watch->tsfn = ThreadSafeFunction::New(info.Env(), info[3].As<Function>(), "watch_gpio", 0, 1,
+        [](Env, s_watch_js* watch) { delete watch; }, watch);
+
+    bool ok = (interval > 0) ? gpiox_watch_coalesce(pin, edge, debounce, interval, on_watch, watch) :
+        gpiox_watch(pin, edge, debounce, on_watch, watch);
+
+    if (!ok)
+    {
+        watch->tsfn.Release();
+        return Boolean::New(info.Env(), false);
+    }
+
+    watch_js[pin] = watch;
+
+    return Boolean::New(info.Env(), true);
+}
+
+Value unwatch_gpio(const CallbackInfo &info)
+{
+    uint32_t pin = info[0].ToNumber().Uint32Value();
+
+    release_watch(pin);
+
+    // stops count
+    return Boolean::New(info.Env(), gpiox_unwatch(pin));
+}
+
+// counts edges of input without callback, unwatch_gpio stops count
+Value count_gpio(const CallbackInfo &info)
+{
+    uint32_t pin      = info[0].ToNumber().Uint32Value();
+    uint32_t edge     = info[1].ToNumber().Uint32Value();
+    uint32_t window   = info[2].ToNumber().Uint32Value();
+    uint32_t debounce = info[3].IsNumber() ? info[3].As<Number>().Uint32Value() : 0;
+
+    release_watch(pin);
+
+    return Boolean::New(info.Env(), gpiox_count(pin, edge, debounce, window));
+}
+
+// returns object with count, rate (edges/s), period (ns) and lost
+Value read_count(const CallbackInfo &info)
+{
+    Env env = info.Env();
+    uint32_t pin = info[0].ToNumber().Uint32Value();
+    gpiox_count_stat stat;
+
+    if (!gpiox_count_read(pin, stat))
+        return env.Undefined();
+
+    Object obj = Object::New(env);
+
+    obj.Set("count", Number::New(env, (double) stat.count));
+    obj.Set("rate", Number::New(env, stat.rate));
+    obj.Set("period", Number::New(env, (double) stat.period_ns));
+    obj.Set("lost", Number::New(env, stat.lost));
+
+    return obj;
+}
+
+// captures pulse width and period of input, unwatch_gpio stops capture
+Value capture_gpio(const CallbackInfo &info)
+{
+    uint32_t pin      = info[0].ToNumber().Uint32Value();
+    uint32_t debounce = info[1].IsNumber() ? info[1].As<Number>().Uint32Value() : 0;
+
+    release_watch(pin);
+
+    return Boolean::New(info.Env(), gpiox_capture(pin, debounce));
+}
+
+// returns object with last, min, max and mean time in ns
+static Object time_object(Env env, const gpiox_time_stat& stat)
+{
+    Object obj = Object::New(env);
+
+    obj.Set("last", Number::New(env, (double) stat.last_ns));
+    obj.Set("min", Number::New(env, (double) stat.min_ns));
+    obj.Set("max", Number::New(env, (double) stat.max_ns));
+    obj.Set("mean", Number::New(env, (double) stat.mean_ns));
+
+    return obj;
+}
+
+// returns object with high, low, period, duty, periods and lost
+Value read_capture(const CallbackInfo &info)
+{
+    Env env = info.Env();
+    uint32_t pin = info[0].ToNumber().Uint32Value();
+    gpiox_capture_stat stat;
+
+    if (!gpiox_capture_read(pin, stat))
+        return env.Undefined();
+
+    Object obj = Object::New(env);
+
+    obj.Set("high", time_object(env, stat.high));
+    obj.Set("low", time_object(env, stat.low));
+    obj.Set("period", time_object(env, stat.period));
+    obj.Set("duty", Number::New(env, stat.duty));
+    obj.Set("periods", Number::New(env, (double) stat.periods));
+    obj.Set("lost", Number::New(env, stat.lost));
+
+    return obj;
+}
+
+// records kernel events of watched pins to rotating segment files path.000, path.001, ...
+Value start_record(const CallbackInfo &info)
+{
+    if (!info[0].IsString())
+        return Boolean::New(info.Env(), false);
+
+    std::string path  = info[0].As<String>().Utf8Value();
+    uint32_t events   = info[1].IsNumber() ? info[1].As<Number>().Uint32Value() : 65536;
+    uint32_t segments = info[2].IsNumber() ? info[2].As<Number>().Uint32Value() : 4;
+
+    return Boolean::New(info.Env(), gpiox_record_start(path.c_str(), events, segments));
+}
+
+Value stop_record(const CallbackInfo &info)
+{
+    gpiox_record_stop();
+
+    return Boolean::New(info.Env(), true);
+}
+
+// initializes quadrature encoder, position is read with read_encoder
+Value init_encoder(const CallbackInfo &info)
+{
+    uint32_t encoder  = info[0].ToNumber().Uint32Value();
+    uint32_t pin_a    = info[1].ToNumber().Uint32Value();
+    uint32_t pin_b    = info[2].ToNumber().Uint32Value();
+    uint32_t mode     = info[3].ToNumber().Uint32Value();
+    uint32_t debounce = info[4].IsNumber() ? info[4].As<Number>().Uint32Value() : 0;
+    uint32_t interval = info[5].IsNumber() ? info[5].As<Number>().Uint32Value() : 100;
+
+    return Boolean::New(info.Env(), gpiox_encoder_init(encoder, pin_a, pin_b, mode, debounce, interval, nullptr, nullptr));
+}
+
+Value deinit_encoder(const CallbackInfo &info)
+{
+    uint32_t encoder = info[0].ToNumber().Uint32Value();
+
+    return Boolean::New(info.Env(), gpiox_encoder_deinit(encoder));
+}
+
+// returns object with position, velocity (counts/s), errors and lost
+Value read_encoder(const CallbackInfo &info)
+{
+    Env env = info.Env();
+    uint32_t encoder = info[0].ToNumber().Uint32Value();
+    gpiox_encoder_stat stat;
+
+    if (!gpiox_encoder_read(encoder, stat))
+        return env.Undefined();
+
+    Object obj = Object::New(env);
+
+    obj.Set("position", Number::New(env, (double) stat.position));
+    obj.Set("velocity", Number::New(env, stat.velocity));
+    obj.Set("errors", Number::New(env, stat.errors));
+    obj.Set("lost", Number::New(env, stat.lost));
+
+    return obj;
+}
+
+// watches array of pins with one line request, callback receives array of events of all pins
+Value watch_bank(const CallbackInfo &info)
+{
+    Env env = info.Env();
+    uint32_t bank     = info[0].ToNumber().Uint32Value();
+    uint32_t mode     = info[2].ToNumber().Uint32Value();
+    uint32_t edge     = info[3].ToNumber().Uint32Value();
+    uint32_t debounce = info[4].ToNumber().Uint32Value();
+
+    if ((bank >= N_BANK) || !info[1].IsArray() || !info[5].IsFunction())
+        return Boolean::New(env, false);
+
+    Array arr = info[1].As<Array>();
+    std::vector<uint32_t> pins;
+
+    for (uint32_t i = 0; i < arr.Length(); i++)
+    {
+        Value pin = arr[i];
+
+        if (!pin.IsNumber())
+            return Boolean::New(env, false);
+
+        pins.push_back(pin.As<Number>().Uint32Value());
+    }
+
+    release_bank(bank);
+
+    s_watch_js* watch = new s_watch_js();
+    watch->posted = false;
+
+    watch->tsfn = ThreadSafeFunction::New(env, info[5].As<Function>(), "watch_bank", 0, 1,
+        [](Env, s_watch_js* watch) { delete watch; }, watch);
+
+    if (!gpiox_watch_bank(bank, pins.data(), pins.size(), mode, edge, debounce, on_watch, watch))
+    {
+        watch->tsfn.Release();
+        return Boolean::New(env, false);
+    }
+
+    bank_js[bank] = watch;
+
+    return Boolean::New(env, true);
+}
+
+Value unwatch_bank(const CallbackInfo &info)
+{
+    uint32_t bank = info[0].ToNumber().Uint32Value();
+
+    release_bank(bank);
+
+    return Boolean::New(info.Env(), bank < N_BANK);
+}
+
+// returns state of bank as BigInt, bit n is pins[n] of watch_bank
+Value read_bank(const CallbackInfo &info)
+{
+    Env env = info.Env();
+    uint32_t bank = info[0].ToNumber().Uint32Value();
+    uint64_t bits;
+
+    if (!gpiox_bank_read(bank, bits))
+        return env.Undefined();
+
+    return BigInt::New(env, bits);
+}
+
+// mirrors state of pins to Int32Array (e.g. on SharedArrayBuffer) with N_PIN + 1 elements
+// empty pins array stops mirror
+Value mirror_gpios(const CallbackInfo &info)
+{
+    Env env = info.Env();
+
+    if (!info[0].IsArray())
+        return Boolean::New(env, false);
+
+    release_mirror();
+
+    Array pins = info[0].As<Array>();
+
+    if (pins.Length() == 0)
+        return Boolean::New(env, true);
+
+    if (!info[1].IsTypedArray() || (info[1].As<TypedArray>().TypedArrayType() != napi_int32_array))
+        return Boolean::New(env, false);
+
+    Int32Array state = info[1].As<Int32Array>();
+    uint32_t debounce = info[2].IsNumber() ? info[2].As<Number>().Uint32Value() : 0;
+
+    if (state.ElementLength() < N_PIN + 1)
+        return Boolean::New(env, false);
+
+    Function notify = env.Global().Get("Atomics").As<Object>().Get("notify").As<Function>();
+
+    s_mirror_js* mirror = new s_mirror_js();
+    mirror->state = Persistent(state.As<Object>());
+    mirror->data = state.Data();
+    mirror->posted = false;
+
+    mirror->tsfn = ThreadSafeFunction::New(env, notify, "mirror_gpios", 0, 1,
+        [](Env, s_mirror_js* mirror) { delete mirror; }, mirror);
+
+    mirror_js = mirror;
+
+    for (uint32_t i = 0; i < pins.Length(); i++)
+    {
+        Value pin = pins[i];
+        uint32_t nr = pin.IsNumber() ? pin.As<Number>().Uint32Value() : N_PIN;
+
+        if ((nr >= N_PIN) || !gpiox_mirror(nr, debounce, mirror->data, on_mirror, mirror))
+        {
+            release_mirror();
+            return Boolean::New(env, false);
+        }
+
+        mirror_mask |= 1U << nr;
+    }
+
+    return Boolean::New(env, true);
+}
+
 #define ADDFN(fn) exports.Set(#fn, Function::New(env, fn))
 #define ADDNUM(num) exports.Set(#num, Number::New(env, num))
 
@@ -69,7 +603,25 @@ Object export_all(Env env, Object exports)
     ADDFN(init_gpio);
     ADDFN(deinit_gpio);
     ADDFN(get_gpio);
+    ADDFN(get_gpio_all);
     ADDFN(set_gpio);
+    ADDFN(read_gpios);
+    ADDFN(write_gpios);
+    ADDFN(watch_gpio);
+    ADDFN(unwatch_gpio);
+    ADDFN(count_gpio);
+    ADDFN(read_count);
+    ADDFN(capture_gpio);
+    ADDFN(read_capture);
+    ADDFN(start_record);
+    ADDFN(stop_record);
+    ADDFN(init_encoder);
+    ADDFN(deinit_encoder);
+    ADDFN(read_encoder);
+    ADDFN(watch_bank);
+    ADDFN(unwatch_bank);
+    ADDFN(read_bank);
+    ADDFN(mirror_gpios);
 
     ADDNUM(GPIO_MODE_INPUT_NOPULL);
     ADDNUM(GPIO_MODE_INPUT_PULLDOWN);
@@ -78,6 +630,10 @@ Object export_all(Env env, Object exports)
     ADDNUM(GPIO_MODE_OUTPUT_SINK);
     ADDNUM(GPIO_MODE_OUTPUT_SOURCE);
 
+    ADDNUM(GPIO_EDGE_RISING);
+    ADDNUM(GPIO_EDGE_FALLING);
+    ADDNUM(GPIO_EDGE_BOTH);
+
     return exports;
 }
 